@@ -78,6 +78,13 @@ static void group_add                   (EelCanvasGroup *group,
 static void group_remove                (EelCanvasGroup *group,
 					 EelCanvasItem  *item);
 static void redraw_and_repick_if_mapped (EelCanvasItem *item);
+static void queue_item_update           (EelCanvasItem  *item,
+					 guint           flags);
+static void group_index_update_item     (EelCanvasItem  *item);
+static void group_index_restack_item    (EelCanvasItem  *item,
+					 GList          *link);
+static GPtrArray *group_get_children_in (EelCanvasGroup *group,
+					 int x1, int y1, int x2, int y2);
 
 /*** EelCanvasItem ***/
 
@@ -430,11 +437,15 @@ eel_canvas_item_invoke_update (EelCanvasItem *item,
 	if (child_flags & GCI_UPDATE_MASK) {
 		if (EEL_CANVAS_ITEM_GET_CLASS (item)->update)
 			EEL_CANVAS_ITEM_GET_CLASS (item)->update (item, i2w_dx, i2w_dy, child_flags);
+		item->canvas->n_items_updated++;
 	}
  
 	/* If this fail you probably forgot to chain up to
 	 * EelCanvasItem::update from a derived class */
  	g_return_if_fail (!(item->flags & EEL_CANVAS_ITEM_NEED_UPDATE));
+
+	if (item->parent != NULL && EEL_CANVAS_GROUP (item->parent)->index != NULL)
+		group_index_update_item (item);
 }
 
 /*
@@ -522,7 +533,7 @@ eel_canvas_item_move (EelCanvasItem *item, double dx, double dy)
 		item->canvas->need_repick = TRUE;
 
 	if (!(item->flags & EEL_CANVAS_ITEM_NEED_DEEP_UPDATE)) {
-		item->flags |= EEL_CANVAS_ITEM_NEED_DEEP_UPDATE;
+		queue_item_update (item, EEL_CANVAS_ITEM_NEED_DEEP_UPDATE);
 		if (item->parent != NULL)
 			eel_canvas_item_request_update (item->parent);
 		else
@@ -590,6 +601,10 @@ put_item_after (GList *link, GList *before)
 		else
 			parent->item_list_end = link;
 	}
+
+	if (parent->index != NULL)
+		group_index_restack_item (EEL_CANVAS_ITEM (link->data), link);
+
 	return TRUE;
 }
 
@@ -1106,6 +1121,29 @@ eel_canvas_item_get_bounds (EelCanvasItem *item, double *x1, double *y1, double
 }
 
 
+/* Puts an item on the dirty list of its parent, unless it is there */
+static void
+add_dirty_item (EelCanvasGroup *group, EelCanvasItem *item)
+{
+	if (item->flags & EEL_CANVAS_ITEM_ON_DIRTY_LIST)
+		return;
+
+	group->dirty_items = g_list_prepend (group->dirty_items, item);
+	item->flags |= EEL_CANVAS_ITEM_ON_DIRTY_LIST;
+}
+
+/* Sets update flags on an item, putting it on the dirty list of its
+ * parent the first time it needs an update.
+ */
+static void
+queue_item_update (EelCanvasItem *item, guint flags)
+{
+	if (item->parent != NULL)
+		add_dirty_item (EEL_CANVAS_GROUP (item->parent), item);
+
+	item->flags |= flags;
+}
+
 /**
  * eel_canvas_item_request_update
  * @item: A canvas item.
@@ -1124,7 +1162,7 @@ eel_canvas_item_request_update (EelCanvasItem *item)
 	if (item->flags & EEL_CANVAS_ITEM_NEED_UPDATE)
 		return;
 
-	item->flags |= EEL_CANVAS_ITEM_NEED_UPDATE;
+	queue_item_update (item, EEL_CANVAS_ITEM_NEED_UPDATE);
 
 	if (item->parent != NULL) {
 		/* Recurse up the tree */
@@ -1197,6 +1235,393 @@ static void   eel_canvas_group_bounds      (EelCanvasItem *item, double *x1, dou
 static EelCanvasItemClass *group_parent_class;
 
 
+/* Groups with at least this many children index them by the canvas
+ * pixel cells their bounds cover, so that drawing and picking only
+ * look at the children near the area being drawn or picked.
+ */
+#define GROUP_INDEX_MIN_ITEMS 256
+#define GROUP_INDEX_CELL_SIZE 128
+/* Children covering more cells than this are kept aside and looked
+ * at by every query instead.
+ */
+#define GROUP_INDEX_MAX_ITEM_CELLS 64
+#define GROUP_INDEX_MAX_CELL (1 << 20)
+
+typedef struct {
+	EelCanvasItem *item;
+
+	/* Position in the stacking order, higher is on top */
+	gint64 stack;
+	/* Last query that collected the child */
+	guint stamp;
+
+	gboolean large;
+	int cx1, cy1, cx2, cy2;
+} GroupIndexEntry;
+
+struct _EelCanvasGroupIndex {
+	/* EelCanvasItem -> GroupIndexEntry */
+	GHashTable *entries;
+	/* Cell key -> GList of GroupIndexEntry */
+	GHashTable *cells;
+	GList *large_entries;
+
+	gint64 top, bottom;
+	gboolean restacked;
+	guint stamp;
+};
+
+static int
+group_index_cell (double coordinate)
+{
+	return (int) CLAMP (floor (coordinate / GROUP_INDEX_CELL_SIZE),
+			    -GROUP_INDEX_MAX_CELL, GROUP_INDEX_MAX_CELL);
+}
+
+/* Keys of cells far apart may collide. That only costs some
+ * extra candidates, which are checked against their bounds anyway.
+ */
+static gpointer
+group_index_cell_key (int cx, int cy)
+{
+	return GUINT_TO_POINTER (((guint) cx & 0xffff) << 16 | ((guint) cy & 0xffff));
+}
+
+static void
+group_index_unlink_entry (EelCanvasGroupIndex *index,
+			  GroupIndexEntry *entry)
+{
+	GList *cell;
+	gpointer key;
+	int cx, cy;
+
+	if (entry->large) {
+		index->large_entries = g_list_remove (index->large_entries, entry);
+		return;
+	}
+
+	for (cy = entry->cy1; cy <= entry->cy2; cy++) {
+		for (cx = entry->cx1; cx <= entry->cx2; cx++) {
+			key = group_index_cell_key (cx, cy);
+			cell = g_hash_table_lookup (index->cells, key);
+			cell = g_list_remove (cell, entry);
+			if (cell != NULL) {
+				g_hash_table_insert (index->cells, key, cell);
+			} else {
+				g_hash_table_remove (index->cells, key);
+			}
+		}
+	}
+}
+
+static void
+group_index_link_entry (EelCanvasGroupIndex *index,
+			GroupIndexEntry *entry)
+{
+	GList *cell;
+	gpointer key;
+	int cx, cy;
+
+	if (entry->large) {
+		index->large_entries = g_list_prepend (index->large_entries, entry);
+		return;
+	}
+
+	for (cy = entry->cy1; cy <= entry->cy2; cy++) {
+		for (cx = entry->cx1; cx <= entry->cx2; cx++) {
+			key = group_index_cell_key (cx, cy);
+			cell = g_hash_table_lookup (index->cells, key);
+			g_hash_table_insert (index->cells, key,
+					     g_list_prepend (cell, entry));
+		}
+	}
+}
+
+/* Files the entry under the cells covered by the current bounds of
+ * its item, unless they are the ones it is already filed under.
+ */
+static void
+group_index_place_entry (EelCanvasGroupIndex *index,
+			 GroupIndexEntry *entry,
+			 gboolean linked)
+{
+	EelCanvasItem *item;
+	int cx1, cy1, cx2, cy2;
+	gboolean large;
+
+	item = entry->item;
+
+	cx1 = group_index_cell (item->x1);
+	cy1 = group_index_cell (item->y1);
+	cx2 = MAX (cx1, group_index_cell (item->x2));
+	cy2 = MAX (cy1, group_index_cell (item->y2));
+	large = (gint64) (cx2 - cx1 + 1) * (cy2 - cy1 + 1) > GROUP_INDEX_MAX_ITEM_CELLS;
+
+	if (linked) {
+		if (large && entry->large) {
+			return;
+		}
+		if (!large && !entry->large &&
+		    cx1 == entry->cx1 && cy1 == entry->cy1 &&
+		    cx2 == entry->cx2 && cy2 == entry->cy2) {
+			return;
+		}
+		group_index_unlink_entry (index, entry);
+	}
+
+	entry->large = large;
+	entry->cx1 = cx1;
+	entry->cy1 = cy1;
+	entry->cx2 = cx2;
+	entry->cy2 = cy2;
+
+	group_index_link_entry (index, entry);
+}
+
+static void
+group_index_add_item (EelCanvasGroup *group,
+		      EelCanvasItem *item)
+{
+	GroupIndexEntry *entry;
+
+	entry = g_slice_new0 (GroupIndexEntry);
+	entry->item = item;
+	entry->stack = ++group->index->top;
+
+	g_hash_table_insert (group->index->entries, item, entry);
+	group_index_place_entry (group->index, entry, FALSE);
+}
+
+static void
+group_index_remove_item (EelCanvasGroup *group,
+			 EelCanvasItem *item)
+{
+	GroupIndexEntry *entry;
+
+	entry = g_hash_table_lookup (group->index->entries, item);
+	if (entry == NULL) {
+		return;
+	}
+
+	group_index_unlink_entry (group->index, entry);
+	g_hash_table_remove (group->index->entries, item);
+	g_slice_free (GroupIndexEntry, entry);
+}
+
+static void
+group_index_update_item (EelCanvasItem *item)
+{
+	EelCanvasGroupIndex *index;
+	GroupIndexEntry *entry;
+
+	index = EEL_CANVAS_GROUP (item->parent)->index;
+	entry = g_hash_table_lookup (index->entries, item);
+	if (entry != NULL) {
+		group_index_place_entry (index, entry, TRUE);
+	}
+}
+
+/* Raising to the top and lowering to the bottom, by far the most
+ * common restacking, are tracked right away. Anything else has the
+ * stacking order read back from the child list on the next query.
+ */
+static void
+group_index_restack_item (EelCanvasItem *item,
+			  GList *link)
+{
+	EelCanvasGroupIndex *index;
+	GroupIndexEntry *entry;
+
+	index = EEL_CANVAS_GROUP (item->parent)->index;
+	entry = g_hash_table_lookup (index->entries, item);
+	if (entry == NULL) {
+		return;
+	}
+
+	if (link->next == NULL) {
+		entry->stack = ++index->top;
+	} else if (link->prev == NULL) {
+		entry->stack = --index->bottom;
+	} else {
+		index->restacked = TRUE;
+	}
+}
+
+static void
+group_index_read_stacking (EelCanvasGroup *group)
+{
+	EelCanvasGroupIndex *index;
+	GroupIndexEntry *entry;
+	GList *list;
+	gint64 stack;
+
+	index = group->index;
+
+	stack = 0;
+	for (list = group->item_list; list; list = list->next) {
+		entry = g_hash_table_lookup (index->entries, list->data);
+		if (entry != NULL) {
+			entry->stack = stack++;
+		}
+	}
+
+	index->bottom = 0;
+	index->top = stack - 1;
+	index->restacked = FALSE;
+}
+
+static void
+group_index_build (EelCanvasGroup *group)
+{
+	GList *list;
+
+	group->index = g_new0 (EelCanvasGroupIndex, 1);
+	group->index->entries = g_hash_table_new (NULL, NULL);
+	group->index->cells = g_hash_table_new (NULL, NULL);
+	group->index->top = -1;
+
+	for (list = group->item_list; list; list = list->next) {
+		group_index_add_item (group, list->data);
+	}
+}
+
+static void
+group_index_free (EelCanvasGroup *group)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	if (group->index == NULL) {
+		return;
+	}
+
+	g_hash_table_iter_init (&iter, group->index->cells);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		g_list_free (value);
+	}
+	g_hash_table_destroy (group->index->cells);
+
+	g_hash_table_iter_init (&iter, group->index->entries);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		g_slice_free (GroupIndexEntry, value);
+	}
+	g_hash_table_destroy (group->index->entries);
+
+	g_list_free (group->index->large_entries);
+	g_free (group->index);
+	group->index = NULL;
+}
+
+static void
+group_index_collect (EelCanvasGroupIndex *index,
+		     GList *entries,
+		     GPtrArray *collected)
+{
+	GroupIndexEntry *entry;
+
+	for (; entries != NULL; entries = entries->next) {
+		entry = entries->data;
+		if (entry->stamp != index->stamp) {
+			entry->stamp = index->stamp;
+			g_ptr_array_add (collected, entry);
+		}
+	}
+}
+
+static int
+group_index_compare_stack (gconstpointer a,
+			   gconstpointer b)
+{
+	const GroupIndexEntry *entry_a, *entry_b;
+
+	entry_a = *(GroupIndexEntry **) a;
+	entry_b = *(GroupIndexEntry **) b;
+
+	if (entry_a->stack < entry_b->stack)
+		return -1;
+	if (entry_a->stack > entry_b->stack)
+		return 1;
+	return 0;
+}
+
+/* Returns the children of the group whose bounds intersect the given
+ * rectangle, bottom-most first. The rectangle is in canvas pixels.
+ */
+static GPtrArray *
+group_get_children_in (EelCanvasGroup *group,
+		       int x1, int y1, int x2, int y2)
+{
+	EelCanvasGroupIndex *index;
+	GPtrArray *children, *entries;
+	GroupIndexEntry *entry;
+	EelCanvasItem *child;
+	GList *list;
+	int cx1, cy1, cx2, cy2, cx, cy;
+	guint i;
+
+	if (group->index == NULL && group->n_items >= GROUP_INDEX_MIN_ITEMS) {
+		group_index_build (group);
+	}
+
+	index = group->index;
+
+	cx1 = group_index_cell (x1);
+	cy1 = group_index_cell (y1);
+	cx2 = MAX (cx1, group_index_cell (x2));
+	cy2 = MAX (cy1, group_index_cell (y2));
+
+	/* Looking at every cell of a huge area costs more than looking
+	 * at every child.
+	 */
+	if (index == NULL ||
+	    (gint64) (cx2 - cx1 + 1) * (cy2 - cy1 + 1) > g_hash_table_size (index->cells)) {
+		children = g_ptr_array_new ();
+		for (list = group->item_list; list; list = list->next) {
+			child = list->data;
+
+			if ((child->x1 > x2) || (child->y1 > y2) || (child->x2 < x1) || (child->y2 < y1))
+				continue;
+
+			g_ptr_array_add (children, child);
+		}
+		return children;
+	}
+
+	if (index->restacked) {
+		group_index_read_stacking (group);
+	}
+
+	index->stamp++;
+	entries = g_ptr_array_new ();
+
+	group_index_collect (index, index->large_entries, entries);
+	for (cy = cy1; cy <= cy2; cy++) {
+		for (cx = cx1; cx <= cx2; cx++) {
+			group_index_collect (index,
+					     g_hash_table_lookup (index->cells,
+								  group_index_cell_key (cx, cy)),
+					     entries);
+		}
+	}
+
+	g_ptr_array_sort (entries, group_index_compare_stack);
+
+	children = g_ptr_array_sized_new (entries->len);
+	for (i = 0; i < entries->len; i++) {
+		entry = g_ptr_array_index (entries, i);
+		child = entry->item;
+
+		if ((child->x1 > x2) || (child->y1 > y2) || (child->x2 < x1) || (child->y2 < y1))
+			continue;
+
+		g_ptr_array_add (children, child);
+	}
+	g_ptr_array_free (entries, TRUE);
+
+	return children;
+}
+
+
 /**
  * eel_canvas_group_get_type:
  *
@@ -1320,7 +1745,7 @@ eel_canvas_group_set_property (GObject *gobject, guint param_id,
 	}
 
 	if (moved) {
-		item->flags |= EEL_CANVAS_ITEM_NEED_DEEP_UPDATE;
+		queue_item_update (item, EEL_CANVAS_ITEM_NEED_DEEP_UPDATE);
 		if (item->parent != NULL)
 			eel_canvas_item_request_update (item->parent);
 		else
@@ -1374,24 +1799,94 @@ eel_canvas_group_destroy (EelCanvasItem *object)
 		eel_canvas_item_destroy (child);
 	}
 
+	group_index_free (group);
+
 	if (EEL_CANVAS_ITEM_CLASS (group_parent_class)->destroy)
 		(* EEL_CANVAS_ITEM_CLASS (group_parent_class)->destroy) (object);
 }
 
+/* Updates only the children of a group that asked for it, growing
+ * the bounds of the group to cover them. Returns FALSE if the bounds
+ * have to be computed again from all the children, because one on
+ * their edge moved or shrank, or because most of them were dirty.
+ */
+static gboolean
+group_update_dirty_items (EelCanvasGroup *group,
+			  GList *dirty_items,
+			  double i2w_dx, double i2w_dy,
+			  int flags)
+{
+	EelCanvasItem *item, *child;
+	GList *list;
+	double x1, y1, x2, y2;
+	gboolean on_edge, bounds_valid;
+
+	item = EEL_CANVAS_ITEM (group);
+
+	if (g_list_length (dirty_items) * 4 > group->n_items)
+		return FALSE;
+
+	bounds_valid = TRUE;
+
+	for (list = dirty_items; list; list = list->next) {
+		child = list->data;
+
+		x1 = child->x1;
+		y1 = child->y1;
+		x2 = child->x2;
+		y2 = child->y2;
+		on_edge = x1 <= item->x1 || y1 <= item->y1 || x2 >= item->x2 || y2 >= item->y2;
+
+		eel_canvas_item_invoke_update (child, i2w_dx + group->xpos, i2w_dy + group->ypos, flags);
+
+		if (child->x1 == x1 && child->y1 == y1 &&
+		    child->x2 == x2 && child->y2 == y2)
+			continue;
+
+		if (on_edge) {
+			bounds_valid = FALSE;
+		} else {
+			item->x1 = MIN (item->x1, child->x1);
+			item->y1 = MIN (item->y1, child->y1);
+			item->x2 = MAX (item->x2, child->x2);
+			item->y2 = MAX (item->y2, child->y2);
+		}
+	}
+
+	return bounds_valid;
+}
+
 /* Update handler for canvas groups */
 static void
 eel_canvas_group_update (EelCanvasItem *item, double i2w_dx, double i2w_dy, int flags)
 {
 	EelCanvasGroup *group;
-	GList *list;
+	GList *list, *dirty_items;
 	EelCanvasItem *i;
 	double bbox_x0, bbox_y0, bbox_x1, bbox_y1;
 	gboolean first = TRUE;
+	gboolean done;
 
 	group = EEL_CANVAS_GROUP (item);
 
 	(* group_parent_class->update) (item, i2w_dx, i2w_dy, flags);
 
+	/* Unless the whole group has to be updated, only visit the
+	 * children that requested it.
+	 */
+	dirty_items = group->dirty_items;
+	group->dirty_items = NULL;
+	for (list = dirty_items; list; list = list->next)
+		EEL_CANVAS_ITEM (list->data)->flags &= ~EEL_CANVAS_ITEM_ON_DIRTY_LIST;
+
+	done = !(flags & EEL_CANVAS_UPDATE_DEEP) && !group->bounds_stale &&
+		group_update_dirty_items (group, dirty_items, i2w_dx, i2w_dy, flags);
+	g_list_free (dirty_items);
+	group->bounds_stale = FALSE;
+
+	if (done)
+		return;
+
 	bbox_x0 = 0;
 	bbox_y0 = 0;
 	bbox_x1 = 0;
@@ -1497,13 +1992,21 @@ eel_canvas_group_draw (EelCanvasItem  *item,
                        cairo_region_t *region)
 {
 	EelCanvasGroup *group;
-	GList *list;
+	GPtrArray *children;
+	cairo_rectangle_int_t extents;
 	EelCanvasItem *child = NULL;
+	guint i;
 
 	group = EEL_CANVAS_GROUP (item);
 
-	for (list = group->item_list; list; list = list->next) {
-		child = list->data;
+	cairo_region_get_extents (region, &extents);
+	children = group_get_children_in (group,
+					  extents.x, extents.y,
+					  extents.x + extents.width,
+					  extents.y + extents.height);
+
+	for (i = 0; i < children->len; i++) {
+		child = g_ptr_array_index (children, i);
 
 		if ((child->flags & EEL_CANVAS_ITEM_MAPPED) &&
 		    (EEL_CANVAS_ITEM_GET_CLASS (child)->draw)) {
@@ -1518,6 +2021,8 @@ eel_canvas_group_draw (EelCanvasItem  *item,
 				EEL_CANVAS_ITEM_GET_CLASS (child)->draw (child, cr, region);
 		}
 	}
+
+	g_ptr_array_free (children, TRUE);
 }
 
 /* Point handler for canvas groups */
@@ -1526,12 +2031,13 @@ eel_canvas_group_point (EelCanvasItem *item, double x, double y, int cx, int cy,
 			EelCanvasItem **actual_item)
 {
 	EelCanvasGroup *group;
-	GList *list;
+	GPtrArray *children;
 	EelCanvasItem *child, *point_item;
 	int x1, y1, x2, y2;
 	double gx, gy;
 	double dist, best;
 	int has_point;
+	guint i;
 
 	group = EEL_CANVAS_GROUP (item);
 
@@ -1548,11 +2054,10 @@ eel_canvas_group_point (EelCanvasItem *item, double x, double y, int cx, int cy,
 
 	dist = 0.0; /* keep gcc happy */
 
-	for (list = group->item_list; list; list = list->next) {
-		child = list->data;
+	children = group_get_children_in (group, x1, y1, x2, y2);
 
-		if ((child->x1 > x2) || (child->y1 > y2) || (child->x2 < x1) || (child->y2 < y1))
-			continue;
+	for (i = 0; i < children->len; i++) {
+		child = g_ptr_array_index (children, i);
 
 		point_item = NULL; /* cater for incomplete item implementations */
 
@@ -1572,6 +2077,8 @@ eel_canvas_group_point (EelCanvasItem *item, double x, double y, int cx, int cy,
 		}
 	}
 
+	g_ptr_array_free (children, TRUE);
+
 	return best;
 }
 
@@ -1674,6 +2181,14 @@ group_add (EelCanvasGroup *group, EelCanvasItem *item)
 	} else
 		group->item_list_end = g_list_append (group->item_list_end, item)->next;
 
+	group->n_items++;
+	if (group->index != NULL)
+		group_index_add_item (group, item);
+
+	/* An item reparented while waiting for an update */
+	if (item->flags & (EEL_CANVAS_ITEM_NEED_UPDATE | EEL_CANVAS_ITEM_NEED_DEEP_UPDATE))
+		add_dirty_item (group, item);
+
 	if (item->flags & EEL_CANVAS_ITEM_VISIBLE &&
 	    group->item.flags & EEL_CANVAS_ITEM_MAPPED) {
 		if (!(item->flags & EEL_CANVAS_ITEM_REALIZED))
@@ -1708,6 +2223,14 @@ group_remove (EelCanvasGroup *group, EelCanvasItem *item)
 			if (item->flags & EEL_CANVAS_ITEM_VISIBLE)
 				eel_canvas_queue_resize (item->canvas);
 
+			if (group->index != NULL)
+				group_index_remove_item (group, item);
+			if (item->flags & EEL_CANVAS_ITEM_ON_DIRTY_LIST) {
+				group->dirty_items = g_list_remove (group->dirty_items, item);
+				item->flags &= ~EEL_CANVAS_ITEM_ON_DIRTY_LIST;
+			}
+			group->bounds_stale = TRUE;
+
 			/* Unparent the child */
 
 			item->parent = NULL;
@@ -1721,6 +2244,7 @@ group_remove (EelCanvasGroup *group, EelCanvasItem *item)
 
 			group->item_list = g_list_remove_link (group->item_list, children);
 			g_list_free (children);
+			group->n_items--;
 			break;
 		}
 }
@@ -3249,6 +3773,8 @@ eel_canvas_draw (GtkWidget *widget, cairo_t *cr)
 	if (canvas->root->flags & EEL_CANVAS_ITEM_MAPPED)
 		EEL_CANVAS_ITEM_GET_CLASS (canvas->root)->draw (canvas->root, cr, region);
 
+	canvas->n_items_updated = 0;
+
 	/* Chain up to get exposes on child widgets */
         if (GTK_WIDGET_CLASS (canvas_parent_class)->draw)
                 GTK_WIDGET_CLASS (canvas_parent_class)->draw (widget, cr);
@@ -3621,6 +4147,24 @@ eel_canvas_update_now (EelCanvas *canvas)
 	do_update (canvas);
 }
 
+/**
+ * eel_canvas_get_n_items_updated:
+ * @canvas: A canvas.
+ *
+ * Returns the number of items whose update method ran since the last frame
+ * was drawn. When called while drawing, this is the number of items that
+ * were updated for the frame being drawn.
+ *
+ * Return value: The number of updated items.
+ **/
+guint
+eel_canvas_get_n_items_updated (EelCanvas *canvas)
+{
+	g_return_val_if_fail (EEL_IS_CANVAS (canvas), 0);
+
+	return canvas->n_items_updated;
+}
+
 /**
  * eel_canvas_get_item_at:
  * @canvas: A canvas.
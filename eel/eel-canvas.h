@@ -69,6 +69,7 @@ typedef struct _EelCanvasItem       EelCanvasItem;
 typedef struct _EelCanvasItemClass  EelCanvasItemClass;
 typedef struct _EelCanvasGroup      EelCanvasGroup;
 typedef struct _EelCanvasGroupClass EelCanvasGroupClass;
+typedef struct _EelCanvasGroupIndex EelCanvasGroupIndex;
 
 
 /* EelCanvasItem - base item class for canvas items
@@ -92,7 +93,9 @@ enum {
 	EEL_CANVAS_ITEM_ALWAYS_REDRAW    = 1 << 6,
 	EEL_CANVAS_ITEM_VISIBLE          = 1 << 7,
 	EEL_CANVAS_ITEM_NEED_UPDATE      = 1 << 8,
-	EEL_CANVAS_ITEM_NEED_DEEP_UPDATE = 1 << 9
+	EEL_CANVAS_ITEM_NEED_DEEP_UPDATE = 1 << 9,
+	/* Internal: the item is on the dirty_items of its parent */
+	EEL_CANVAS_ITEM_ON_DIRTY_LIST    = 1 << 10
 };
 
 /* Update flags for items */
@@ -329,6 +332,20 @@ struct _EelCanvasGroup {
 	/* Children of the group */
 	GList *item_list;
 	GList *item_list_end;
+	guint n_items;
+
+	/* Spatial index over the bounds of the children, built once the
+	 * group is large enough to make linear scans expensive.
+	 */
+	EelCanvasGroupIndex *index;
+
+	/* Children that requested an update since the last one */
+	GList *dirty_items;
+
+	/* Set when a child was removed, as the bounds then have to be
+	 * computed again from all the children.
+	 */
+	guint bounds_stale : 1;
 };
 
 struct _EelCanvasGroupClass {
@@ -382,6 +399,9 @@ struct _EelCanvas {
 	/* Idle handler ID */
 	guint idle_id;
 
+	/* Number of items updated since the last frame was drawn */
+	guint n_items_updated;
+
 	/* Signal handler ID for destruction of the root item */
 	guint root_destroy_id;
 
@@ -479,6 +499,11 @@ void eel_canvas_get_scroll_offsets (EelCanvas *canvas, int *cx, int *cy);
  */
 void eel_canvas_update_now (EelCanvas *canvas);
 
+/* Returns the number of items that were updated for the frame being drawn.
+ * Meant for debugging and profiling.
+ */
+guint eel_canvas_get_n_items_updated (EelCanvas *canvas);
+
 /* Returns the item that is at the specified position in world coordinates, or
  * NULL if no item is there.
  */
@@ -33,6 +33,10 @@
 #include <math.h>
 #include <string.h>
 
+#ifdef HAVE_X86_VECTOR_TARGETS
+#include <immintrin.h>
+#endif
+
 /* shared utility to create a new pixbuf from the passed-in one */
 
 static GdkPixbuf *
@@ -51,6 +55,24 @@ create_new_pixbuf (GdkPixbuf *src)
 			       gdk_pixbuf_get_height (src));
 }
 
+/* The effects below work on whole rows at a time, using SSE2 or AVX2
+ * when the processor has them. Every kernel gives the same result as
+ * the scalar one, byte for byte.
+ */
+
+typedef void (* SpotlightRowFunction) (const guchar *src,
+				       guchar *dest,
+				       int width,
+				       gboolean has_alpha);
+typedef void (* ColorizeRowFunction) (const guchar *src,
+				      guchar *dest,
+				      int width,
+				      gboolean has_alpha,
+				      const int *multipliers);
+
+static SpotlightRowFunction spotlight_row;
+static ColorizeRowFunction colorize_row;
+
 /* utility routine to bump the level of a color component with pinning */
 
 static guchar
@@ -64,14 +86,275 @@ lighten_component (guchar cur_value)
 	return (guchar) new_value;
 }
 
+/* The vector kernels hand the bytes they did not get to over to
+ * these, always starting on a pixel boundary.
+ */
+static void
+spotlight_bytes_scalar (const guchar *src,
+			guchar *dest,
+			int n_bytes,
+			gboolean has_alpha)
+{
+	int i;
+
+	for (i = 0; i < n_bytes; i++) {
+		if (has_alpha && (i & 3) == 3) {
+			dest[i] = src[i];
+		} else {
+			dest[i] = lighten_component (src[i]);
+		}
+	}
+}
+
+static void
+colorize_bytes_scalar (const guchar *src,
+		       guchar *dest,
+		       int n_bytes,
+		       gboolean has_alpha,
+		       const int *multipliers)
+{
+	int i, channel, n_channels;
+
+	n_channels = has_alpha ? 4 : 3;
+
+	for (i = 0, channel = 0; i < n_bytes; i++) {
+		if (channel == 3) {
+			dest[i] = src[i];
+		} else {
+			dest[i] = (src[i] * multipliers[channel]) >> 8;
+		}
+		if (++channel == n_channels) {
+			channel = 0;
+		}
+	}
+}
+
+static void
+spotlight_row_scalar (const guchar *src,
+		      guchar *dest,
+		      int width,
+		      gboolean has_alpha)
+{
+	spotlight_bytes_scalar (src, dest, width * (has_alpha ? 4 : 3), has_alpha);
+}
+
+static void
+colorize_row_scalar (const guchar *src,
+		     guchar *dest,
+		     int width,
+		     gboolean has_alpha,
+		     const int *multipliers)
+{
+	colorize_bytes_scalar (src, dest, width * (has_alpha ? 4 : 3), has_alpha, multipliers);
+}
+
+#ifdef HAVE_X86_VECTOR_TARGETS
+
+/* Lightening adds 24 and the top five bits of each byte, saturating.
+ * Alpha bytes are the top byte of each little endian 32 bit pixel.
+ */
+__attribute__ ((target ("sse2"))) static void
+spotlight_row_sse2 (const guchar *src,
+		    guchar *dest,
+		    int width,
+		    gboolean has_alpha)
+{
+	__m128i bias, low_bits, alpha_mask, pixels, lightened;
+	int i, n_bytes;
+
+	n_bytes = width * (has_alpha ? 4 : 3);
+	bias = _mm_set1_epi8 (24);
+	low_bits = _mm_set1_epi8 (0x1f);
+	alpha_mask = has_alpha ? _mm_set1_epi32 ((int) 0xff000000) : _mm_setzero_si128 ();
+
+	for (i = 0; i + 16 <= n_bytes; i += 16) {
+		pixels = _mm_loadu_si128 ((const __m128i *) (src + i));
+		lightened = _mm_and_si128 (_mm_srli_epi16 (pixels, 3), low_bits);
+		lightened = _mm_adds_epu8 (pixels, _mm_add_epi8 (lightened, bias));
+		lightened = _mm_or_si128 (_mm_andnot_si128 (alpha_mask, lightened),
+					  _mm_and_si128 (alpha_mask, pixels));
+		_mm_storeu_si128 ((__m128i *) (dest + i), lightened);
+	}
+
+	spotlight_bytes_scalar (src + i, dest + i, n_bytes - i, has_alpha);
+}
+
+__attribute__ ((target ("avx2"))) static void
+spotlight_row_avx2 (const guchar *src,
+		    guchar *dest,
+		    int width,
+		    gboolean has_alpha)
+{
+	__m256i bias, low_bits, alpha_mask, pixels, lightened;
+	int i, n_bytes;
+
+	n_bytes = width * (has_alpha ? 4 : 3);
+	bias = _mm256_set1_epi8 (24);
+	low_bits = _mm256_set1_epi8 (0x1f);
+	alpha_mask = has_alpha ? _mm256_set1_epi32 ((int) 0xff000000) : _mm256_setzero_si256 ();
+
+	for (i = 0; i + 32 <= n_bytes; i += 32) {
+		pixels = _mm256_loadu_si256 ((const __m256i *) (src + i));
+		lightened = _mm256_and_si256 (_mm256_srli_epi16 (pixels, 3), low_bits);
+		lightened = _mm256_adds_epu8 (pixels, _mm256_add_epi8 (lightened, bias));
+		lightened = _mm256_blendv_epi8 (lightened, pixels, alpha_mask);
+		_mm256_storeu_si256 ((__m256i *) (dest + i), lightened);
+	}
+
+	spotlight_bytes_scalar (src + i, dest + i, n_bytes - i, has_alpha);
+}
+
+/* Multiplies eight bytes widened to 16 bits with a multiplier each.
+ * Alpha gets 256, which leaves it as it is after the shift.
+ */
+__attribute__ ((target ("sse2"))) static inline __m128i
+colorize_half_sse2 (__m128i half,
+		    __m128i multipliers)
+{
+	return _mm_srli_epi16 (_mm_mullo_epi16 (half, multipliers), 8);
+}
+
+__attribute__ ((target ("sse2"))) static inline void
+colorize_16_bytes_sse2 (const guchar *src,
+			guchar *dest,
+			__m128i low_multipliers,
+			__m128i high_multipliers)
+{
+	__m128i zero, pixels, low, high;
+
+	zero = _mm_setzero_si128 ();
+	pixels = _mm_loadu_si128 ((const __m128i *) src);
+	low = colorize_half_sse2 (_mm_unpacklo_epi8 (pixels, zero), low_multipliers);
+	high = colorize_half_sse2 (_mm_unpackhi_epi8 (pixels, zero), high_multipliers);
+	_mm_storeu_si128 ((__m128i *) dest, _mm_packus_epi16 (low, high));
+}
+
+__attribute__ ((target ("sse2"))) static void
+colorize_row_sse2 (const guchar *src,
+		   guchar *dest,
+		   int width,
+		   gboolean has_alpha,
+		   const int *multipliers)
+{
+	__m128i rgba, rgb, brg, gbr;
+	int i, n_bytes, r, g, b;
+
+	r = multipliers[0];
+	g = multipliers[1];
+	b = multipliers[2];
+
+	if (has_alpha) {
+		n_bytes = width * 4;
+		rgba = _mm_setr_epi16 (r, g, b, 256, r, g, b, 256);
+		for (i = 0; i + 16 <= n_bytes; i += 16) {
+			colorize_16_bytes_sse2 (src + i, dest + i, rgba, rgba);
+		}
+	} else {
+		/* Three channels line up with the vectors every 48 bytes */
+		n_bytes = width * 3;
+		rgb = _mm_setr_epi16 (r, g, b, r, g, b, r, g);
+		brg = _mm_setr_epi16 (b, r, g, b, r, g, b, r);
+		gbr = _mm_setr_epi16 (g, b, r, g, b, r, g, b);
+		for (i = 0; i + 48 <= n_bytes; i += 48) {
+			colorize_16_bytes_sse2 (src + i, dest + i, rgb, brg);
+			colorize_16_bytes_sse2 (src + i + 16, dest + i + 16, gbr, rgb);
+			colorize_16_bytes_sse2 (src + i + 32, dest + i + 32, brg, gbr);
+		}
+	}
+
+	colorize_bytes_scalar (src + i, dest + i, n_bytes - i, has_alpha, multipliers);
+}
+
+/* AVX2 unpacks within each 128 bit lane, which only keeps the
+ * multipliers in step when pixels have four channels.
+ */
+__attribute__ ((target ("avx2"))) static void
+colorize_row_avx2 (const guchar *src,
+		   guchar *dest,
+		   int width,
+		   gboolean has_alpha,
+		   const int *multipliers)
+{
+	__m256i zero, rgba, pixels, low, high;
+	int i, n_bytes, r, g, b;
+
+	if (!has_alpha) {
+		colorize_row_sse2 (src, dest, width, has_alpha, multipliers);
+		return;
+	}
+
+	r = multipliers[0];
+	g = multipliers[1];
+	b = multipliers[2];
+
+	n_bytes = width * 4;
+	zero = _mm256_setzero_si256 ();
+	rgba = _mm256_setr_epi16 (r, g, b, 256, r, g, b, 256,
+				  r, g, b, 256, r, g, b, 256);
+
+	for (i = 0; i + 32 <= n_bytes; i += 32) {
+		pixels = _mm256_loadu_si256 ((const __m256i *) (src + i));
+		low = _mm256_srli_epi16 (_mm256_mullo_epi16 (_mm256_unpacklo_epi8 (pixels, zero), rgba), 8);
+		high = _mm256_srli_epi16 (_mm256_mullo_epi16 (_mm256_unpackhi_epi8 (pixels, zero), rgba), 8);
+		_mm256_storeu_si256 ((__m256i *) (dest + i), _mm256_packus_epi16 (low, high));
+	}
+
+	colorize_bytes_scalar (src + i, dest + i, n_bytes - i, has_alpha, multipliers);
+}
+
+#endif /* HAVE_X86_VECTOR_TARGETS */
+
+gboolean
+eel_graphic_effects_use_kernels (EelPixelKernels kernels)
+{
+	switch (kernels) {
+	case EEL_PIXEL_KERNELS_SCALAR:
+		spotlight_row = spotlight_row_scalar;
+		colorize_row = colorize_row_scalar;
+		return TRUE;
+#ifdef HAVE_X86_VECTOR_TARGETS
+	case EEL_PIXEL_KERNELS_SSE2:
+		__builtin_cpu_init ();
+		if (!__builtin_cpu_supports ("sse2")) {
+			return FALSE;
+		}
+		spotlight_row = spotlight_row_sse2;
+		colorize_row = colorize_row_sse2;
+		return TRUE;
+	case EEL_PIXEL_KERNELS_AVX2:
+		__builtin_cpu_init ();
+		if (!__builtin_cpu_supports ("avx2")) {
+			return FALSE;
+		}
+		spotlight_row = spotlight_row_avx2;
+		colorize_row = colorize_row_avx2;
+		return TRUE;
+#endif
+	default:
+		return FALSE;
+	}
+}
+
+static void
+init_kernels (void)
+{
+	if (spotlight_row != NULL) {
+		return;
+	}
+
+	if (!eel_graphic_effects_use_kernels (EEL_PIXEL_KERNELS_AVX2) &&
+	    !eel_graphic_effects_use_kernels (EEL_PIXEL_KERNELS_SSE2)) {
+		eel_graphic_effects_use_kernels (EEL_PIXEL_KERNELS_SCALAR);
+	}
+}
+
 GdkPixbuf *
 eel_create_spotlight_pixbuf (GdkPixbuf* src)
 {
 	GdkPixbuf *dest;
-	int i, j;
+	int i;
 	int width, height, has_alpha, src_row_stride, dst_row_stride;
 	guchar *target_pixels, *original_pixels;
-	guchar *pixsrc, *pixdest;
 
 	g_return_val_if_fail (gdk_pixbuf_get_colorspace (src) == GDK_COLORSPACE_RGB, NULL);
 	g_return_val_if_fail ((!gdk_pixbuf_get_has_alpha (src)
@@ -80,6 +363,8 @@ eel_create_spotlight_pixbuf (GdkPixbuf* src)
 				  && gdk_pixbuf_get_n_channels (src) == 4), NULL);
 	g_return_val_if_fail (gdk_pixbuf_get_bits_per_sample (src) == 8, NULL);
 
+	init_kernels ();
+
 	dest = create_new_pixbuf (src);
 	
 	has_alpha = gdk_pixbuf_get_has_alpha (src);
@@ -91,16 +376,9 @@ eel_create_spotlight_pixbuf (GdkPixbuf* src)
 	original_pixels = gdk_pixbuf_get_pixels (src);
 
 	for (i = 0; i < height; i++) {
-		pixdest = target_pixels + i * dst_row_stride;
-		pixsrc = original_pixels + i * src_row_stride;
-		for (j = 0; j < width; j++) {		
-			*pixdest++ = lighten_component (*pixsrc++);
-			*pixdest++ = lighten_component (*pixsrc++);
-			*pixdest++ = lighten_component (*pixsrc++);
-			if (has_alpha) {
-				*pixdest++ = *pixsrc++;
-			}
-		}
+		spotlight_row (original_pixels + i * src_row_stride,
+			       target_pixels + i * dst_row_stride,
+			       width, has_alpha);
 	}
 	return dest;
 }
@@ -111,14 +389,12 @@ GdkPixbuf *
 eel_create_colorized_pixbuf (GdkPixbuf *src,
 			     GdkRGBA *color)
 {
-	int i, j;
+	int i;
 	int width, height, has_alpha, src_row_stride, dst_row_stride;
 	guchar *target_pixels;
 	guchar *original_pixels;
-	guchar *pixsrc;
-	guchar *pixdest;
 	GdkPixbuf *dest;
-	gint red_value, green_value, blue_value;
+	int multipliers[3];
 
 	g_return_val_if_fail (gdk_pixbuf_get_colorspace (src) == GDK_COLORSPACE_RGB, NULL);
 	g_return_val_if_fail ((!gdk_pixbuf_get_has_alpha (src)
@@ -127,9 +403,11 @@ eel_create_colorized_pixbuf (GdkPixbuf *src,
 				  && gdk_pixbuf_get_n_channels (src) == 4), NULL);
 	g_return_val_if_fail (gdk_pixbuf_get_bits_per_sample (src) == 8, NULL);
 
-	red_value = (gint) floor (color->red * 255);
-	green_value = (gint) floor (color->green * 255);
-	blue_value = (gint) floor (color->blue * 255);	
+	init_kernels ();
+
+	multipliers[0] = CLAMP ((gint) floor (color->red * 255), 0, 255);
+	multipliers[1] = CLAMP ((gint) floor (color->green * 255), 0, 255);
+	multipliers[2] = CLAMP ((gint) floor (color->blue * 255), 0, 255);
 
 	dest = create_new_pixbuf (src);
 	
@@ -142,16 +420,9 @@ eel_create_colorized_pixbuf (GdkPixbuf *src,
 	original_pixels = gdk_pixbuf_get_pixels (src);
 
 	for (i = 0; i < height; i++) {
-		pixdest = target_pixels + i*dst_row_stride;
-		pixsrc = original_pixels + i*src_row_stride;
-		for (j = 0; j < width; j++) {		
-			*pixdest++ = (*pixsrc++ * red_value) >> 8;
-			*pixdest++ = (*pixsrc++ * green_value) >> 8;
-			*pixdest++ = (*pixsrc++ * blue_value) >> 8;
-			if (has_alpha) {
-				*pixdest++ = *pixsrc++;
-			}
-		}
+		colorize_row (original_pixels + i * src_row_stride,
+			      target_pixels + i * dst_row_stride,
+			      width, has_alpha, multipliers);
 	}
 	return dest;
 }
@@ -35,6 +35,18 @@ GdkPixbuf *eel_create_spotlight_pixbuf (GdkPixbuf *source_pixbuf);
 GdkPixbuf* eel_create_colorized_pixbuf (GdkPixbuf *source_pixbuf,
 					GdkRGBA *color);
 
+typedef enum {
+	EEL_PIXEL_KERNELS_SCALAR,
+	EEL_PIXEL_KERNELS_SSE2,
+	EEL_PIXEL_KERNELS_AVX2
+} EelPixelKernels;
+
+/* Selects the implementation of the effects above. The fastest one the
+ * processor supports is used by default; this is for benchmarks and tests.
+ * Returns FALSE if @kernels cannot be used on this processor.
+ */
+gboolean   eel_graphic_effects_use_kernels (EelPixelKernels kernels);
+
 /* embed in image in a frame */
 GdkPixbuf *eel_embed_image_in_frame    (GdkPixbuf *source_image,
 					GdkPixbuf *frame_image,
@@ -251,8 +251,13 @@ enum {
 	LAST_SIGNAL
 };
 
+/* For every cell, free_below holds the number of free cells from it
+ * downwards in its column, itself included, and 0 if it is taken.
+ * That makes checking a position one lookup per column, and tells
+ * how far down the next position that could be free is.
+ */
 typedef struct {
-	int **icon_grid;
+	int **free_below;
 	int *grid_memory;
 	int num_rows;
 	int num_columns;
@@ -1638,7 +1643,7 @@ placement_grid_new (NautilusCanvasContainer *container, gboolean tight)
 	int width, height;
 	int num_columns;
 	int num_rows;
-	int i;
+	int i, y;
 	GtkAllocation allocation;
 
 	/* Get container dimensions */
@@ -1659,10 +1664,13 @@ placement_grid_new (NautilusCanvasContainer *container, gboolean tight)
 	grid->num_rows = num_rows;
 
 	grid->grid_memory = g_new0 (int, (num_rows * num_columns));
-	grid->icon_grid = g_new0 (int *, num_columns);
+	grid->free_below = g_new0 (int *, num_columns);
 	
 	for (i = 0; i < num_columns; i++) {
-		grid->icon_grid[i] = grid->grid_memory + (i * num_rows);
+		grid->free_below[i] = grid->grid_memory + (i * num_rows);
+		for (y = 0; y < num_rows; y++) {
+			grid->free_below[i][y] = num_rows - y;
+		}
 	}
 	
 	return grid;
@@ -1671,30 +1679,36 @@ placement_grid_new (NautilusCanvasContainer *container, gboolean tight)
 static void
 placement_grid_free (PlacementGrid *grid)
 {
-	g_free (grid->icon_grid);
+	g_free (grid->free_below);
 	g_free (grid->grid_memory);
 	g_free (grid);
 }
 
-static gboolean
-placement_grid_position_is_free (PlacementGrid *grid, EelIRect pos)
+/* Returns -1 if @pos is free. Otherwise returns the lowest row that
+ * is the first taken cell of one of the columns of @pos, so that
+ * every position further down which still covers that row is taken
+ * as well.
+ */
+static int
+placement_grid_get_collision_row (PlacementGrid *grid, EelIRect pos)
 {
-	int x, y;
+	int x, row, collision_row;
 	
 	g_assert (pos.x0 >= 0 && pos.x0 < grid->num_columns);
 	g_assert (pos.y0 >= 0 && pos.y0 < grid->num_rows);
 	g_assert (pos.x1 >= 0 && pos.x1 < grid->num_columns);
 	g_assert (pos.y1 >= 0 && pos.y1 < grid->num_rows);
 
+	collision_row = -1;
+
 	for (x = pos.x0; x <= pos.x1; x++) {
-		for (y = pos.y0; y <= pos.y1; y++) {
-			if (grid->icon_grid[x][y] != 0) {
-				return FALSE;
-			}
+		row = pos.y0 + grid->free_below[x][pos.y0];
+		if (row <= pos.y1) {
+			collision_row = MAX (collision_row, row);
 		}
 	}
 
-	return TRUE;
+	return collision_row;
 }
 
 static void
@@ -1709,7 +1723,12 @@ placement_grid_mark (PlacementGrid *grid, EelIRect pos)
 
 	for (x = pos.x0; x <= pos.x1; x++) {
 		for (y = pos.y0; y <= pos.y1; y++) {
-			grid->icon_grid[x][y] = 1;
+			grid->free_below[x][y] = 0;
+		}
+
+		/* The free cells right above now end at pos.y0 */
+		for (y = pos.y0 - 1; y >= 0 && grid->free_below[x][y] > pos.y0 - y; y--) {
+			grid->free_below[x][y] = pos.y0 - y;
 		}
 	}
 }
@@ -1773,6 +1792,7 @@ find_empty_location (NautilusCanvasContainer *container,
 	EelIRect icon_position;
 	EelDRect pixbuf_rect;
 	gboolean collision;
+	int collision_row;
 	GtkAllocation allocation;
 
 	/* Get container dimensions */
@@ -1815,24 +1835,29 @@ find_empty_location (NautilusCanvasContainer *container,
 
 		need_new_column = icon_position.y0 + height_for_bound_check + DESKTOP_PAD_VERTICAL > canvas_height;
 
-		if (need_new_column ||
-		    !placement_grid_position_is_free (grid, grid_position)) {
-			icon_position.y0 += SNAP_SIZE_Y;
+		if (need_new_column) {
+			/* Move to the next column */
+			icon_position.y0 = DESKTOP_PAD_VERTICAL + SNAP_SIZE_Y - (pixbuf_rect.y1 - pixbuf_rect.y0);
+			while (icon_position.y0 < DESKTOP_PAD_VERTICAL) {
+				icon_position.y0 += SNAP_SIZE_Y;
+			}
 			icon_position.y1 = icon_position.y0 + icon_height;
 			
-			if (need_new_column) {
-				/* Move to the next column */
-				icon_position.y0 = DESKTOP_PAD_VERTICAL + SNAP_SIZE_Y - (pixbuf_rect.y1 - pixbuf_rect.y0);
-				while (icon_position.y0 < DESKTOP_PAD_VERTICAL) {
-					icon_position.y0 += SNAP_SIZE_Y;
-				}
+			icon_position.x0 += SNAP_SIZE_X;
+			icon_position.x1 = icon_position.x0 + icon_width;
+
+			collision = TRUE;
+		} else {
+			collision_row = placement_grid_get_collision_row (grid, grid_position);
+			if (collision_row >= 0) {
+				/* Each step down moves the grid position by one row, so
+				 * skip all the positions still covering collision_row.
+				 */
+				icon_position.y0 += (collision_row - grid_position.y0 + 1) * SNAP_SIZE_Y;
 				icon_position.y1 = icon_position.y0 + icon_height;
-				
-				icon_position.x0 += SNAP_SIZE_X;
-				icon_position.x1 = icon_position.x0 + icon_width;
+
+				collision = TRUE;
 			}
-				
-			collision = TRUE;
 		}
 	} while (collision && (icon_position.x1 < canvas_width));
 
@@ -2097,9 +2122,32 @@ lay_down_icons_vertical_desktop (NautilusCanvasContainer *container, GList *icon
 }
 
 
+/* Measures the labels of @icons before they are placed, in worker
+ * threads when there are enough of them that are not known yet.
+ */
+static void
+measure_icon_labels (GList *icons)
+{
+	GPtrArray *items;
+	NautilusCanvasIcon *icon;
+	GList *p;
+
+	items = g_ptr_array_new ();
+	for (p = icons; p != NULL; p = p->next) {
+		icon = p->data;
+		g_ptr_array_add (items, icon->item);
+	}
+
+	nautilus_canvas_item_measure_labels (items);
+
+	g_ptr_array_free (items, TRUE);
+}
+
 static void
 lay_down_icons (NautilusCanvasContainer *container, GList *icons, double start_y)
 {
+	measure_icon_labels (icons);
+
 	switch (container->details->layout_mode)
 		{
 		case NAUTILUS_CANVAS_LAYOUT_L_R_T_B:
@@ -2259,6 +2307,8 @@ invalidate_label_sizes (NautilusCanvasContainer *container)
 {
 	GList *p;
 	NautilusCanvasIcon *icon;
+
+	container->details->label_font = NULL;
 	
 	for (p = container->details->icons; p != NULL; p = p->next) {
 		icon = p->data;
@@ -2273,6 +2323,8 @@ invalidate_labels (NautilusCanvasContainer *container)
 {
 	GList *p;
 	NautilusCanvasIcon *icon;
+
+	container->details->label_font = NULL;
 	
 	for (p = container->details->icons; p != NULL; p = p->next) {
 		icon = p->data;
@@ -4182,6 +4234,8 @@ style_updated (GtkWidget *widget)
 
 	container = NAUTILUS_CANVAS_CONTAINER (widget);
 	container->details->use_drop_shadows = container->details->drop_shadows_requested;
+	/* The font may have changed even while not realized */
+	container->details->label_font = NULL;
 
 	/* Don't chain up to parent, if this is a desktop container,
 	 * because that resets the background of the window.
@@ -4919,6 +4973,9 @@ static void
 draw_canvas_background (EelCanvas *icon,
                         cairo_t   *cr)
 {
+	DEBUG ("Drawing frame, %u canvas items updated",
+	       eel_canvas_get_n_items_updated (icon));
+
 	/* Don't chain up to the parent to avoid clearing and redrawing */
 }
 
@@ -31,10 +31,15 @@
 #include "nautilus-file-utilities.h"
 #include "nautilus-global-preferences.h"
 #include "nautilus-canvas-private.h"
+#include "nautilus-icon-effects.h"
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_CANVAS_CONTAINER
+#include "nautilus-debug.h"
+
 #include <eel/eel-art-extensions.h>
+#include <eel/eel-debug.h>
 #include <eel/eel-gdk-extensions.h>
 #include <eel/eel-glib-extensions.h>
-#include <eel/eel-graphic-effects.h>
 #include <eel/eel-string.h>
 #include <eel/eel-accessibility.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
@@ -46,6 +51,7 @@
 #include <atk/atknoopobject.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 /* gap between bottom of icon and start of text box */
 #define LABEL_OFFSET 1
@@ -182,6 +188,14 @@ static void     draw_pixbuf                          (GdkPixbuf
 static PangoLayout *get_label_layout                 (PangoLayout                  **layout,
 						      NautilusCanvasItem        *item,
 						      const char                    *text);
+static PangoFontDescription *create_label_font_description (NautilusCanvasContainer *container,
+							    PangoContext            *context);
+static PangoAlignment get_label_alignment            (NautilusCanvasContainer   *container);
+static char *   zeroify_label_text                   (const char                    *text);
+static void     setup_label_layout                   (PangoLayout                   *layout,
+						      const char                    *text,
+						      PangoAlignment                 alignment,
+						      const PangoFontDescription    *desc);
 static gboolean hit_test_stretch_handle              (NautilusCanvasItem        *item,
 						      EelIRect                       icon_rect,
 						      GtkCornerType *corner);
@@ -838,66 +852,575 @@ prepare_pango_layout_width (NautilusCanvasItem *item,
 	}
 }
 
-static void
-prepare_pango_layout_for_measure_entire_text (NautilusCanvasItem *item,
-					      PangoLayout *layout)
-{
-	NautilusCanvasContainer *container;
-
-	prepare_pango_layout_width (item, layout);
-
-	container = NAUTILUS_CANVAS_CONTAINER (EEL_CANVAS_ITEM (item)->canvas);
-
-	if (IS_COMPACT_VIEW (container)) {
-		pango_layout_set_height (layout, -1);
-	} else {
-		pango_layout_set_height (layout, G_MININT);
-	}
-}
+typedef struct {
+	int width;
+	int height;
+	int dx;
+	int height_for_entire_text;
+	int height_for_layout;
+} LabelSize;
+
+/* Everything about an item that the size of one of its labels
+ * depends on, apart from the font and the text itself.
+ */
+typedef struct {
+	int max_text_width;
+	gboolean compact;
+	int height_for_draw;
+	gboolean for_layout;
+	int max_layout_lines;
+} LabelMeasureParams;
 
-static void
-prepare_pango_layout_for_draw (NautilusCanvasItem *item,
-			       PangoLayout *layout)
+static int
+get_label_height_for_draw (NautilusCanvasItem *item)
 {
 	NautilusCanvasItemDetails *details;
 	NautilusCanvasContainer *container;
 	gboolean needs_highlight;
 
-	prepare_pango_layout_width (item, layout);
-
 	container = NAUTILUS_CANVAS_CONTAINER (EEL_CANVAS_ITEM (item)->canvas);
 	details = item->details;
 
 	needs_highlight = details->is_highlighted_for_selection || details->is_highlighted_for_drop;
 
 	if (IS_COMPACT_VIEW (container)) {
-		pango_layout_set_height (layout, -1);
+		return -1;
 	} else if (needs_highlight ||
 		   details->is_prelit ||
 		   details->is_highlighted_as_keyboard_focus ||
 		   details->entire_text ||
 		   container->details->label_position == NAUTILUS_CANVAS_LABEL_POSITION_BESIDE) {
 		/* VOODOO-TODO, cf. compute_text_rectangle() */
-		pango_layout_set_height (layout, G_MININT);
+		return G_MININT;
 	} else {
 		/* TODO? we might save some resources, when the re-layout is not neccessary in case
 		 * the layout height already fits into max. layout lines. But pango should figure this
 		 * out itself (which it doesn't ATM).
 		 */
-		pango_layout_set_height (layout,
-					 nautilus_canvas_container_get_max_layout_lines_for_pango (container));
+		return nautilus_canvas_container_get_max_layout_lines_for_pango (container);
+	}
+}
+
+static void
+prepare_pango_layout_for_draw (NautilusCanvasItem *item,
+			       PangoLayout *layout)
+{
+	prepare_pango_layout_width (item, layout);
+	pango_layout_set_height (layout, get_label_height_for_draw (item));
+}
+
+static void
+get_label_measure_params (NautilusCanvasItem *item,
+			  gboolean for_layout,
+			  LabelMeasureParams *params)
+{
+	NautilusCanvasContainer *container;
+	double max_text_width;
+
+	container = NAUTILUS_CANVAS_CONTAINER (EEL_CANVAS_ITEM (item)->canvas);
+	max_text_width = nautilus_canvas_item_get_max_text_width (item);
+
+	params->max_text_width = max_text_width < 0 ? -1 : floor (max_text_width);
+	params->compact = IS_COMPACT_VIEW (container);
+	params->height_for_draw = get_label_height_for_draw (item);
+	params->for_layout = for_layout;
+	params->max_layout_lines = for_layout ? nautilus_canvas_container_get_max_layout_lines (container) : 0;
+}
+
+/* Does not touch anything but @layout, so that it can also be used
+ * for layouts living in another thread.
+ */
+static void
+measure_label_layout (PangoLayout *layout,
+		      const LabelMeasureParams *params,
+		      LabelSize *size)
+{
+	memset (size, 0, sizeof (LabelSize));
+
+	if (params->max_text_width < 0) {
+		pango_layout_set_width (layout, -1);
+	} else {
+		pango_layout_set_width (layout, params->max_text_width * PANGO_SCALE);
+		pango_layout_set_ellipsize (layout, PANGO_ELLIPSIZE_END);
+	}
+
+	if (params->for_layout) {
+		/* first, measure required text height: height_for_entire_text
+		 * then, measure text height applicable for layout: height_for_layout
+		 */
+		pango_layout_set_height (layout, params->compact ? -1 : G_MININT);
+		layout_get_full_size (layout,
+				      NULL,
+				      &size->height_for_entire_text,
+				      NULL);
+		layout_get_size_for_layout (layout,
+					    params->max_layout_lines,
+					    size->height_for_entire_text,
+					    &size->height_for_layout);
+	}
+
+	/* next, measure actually displayed size */
+	pango_layout_set_height (layout, params->height_for_draw);
+	layout_get_full_size (layout,
+			      &size->width,
+			      &size->height,
+			      &size->dx);
+}
+
+/* Label sizes are shared between all items, so that a label is only
+ * shaped again when its text or the way it is shown changes, like
+ * when going back to a zoom level that was used before. The key holds
+ * everything the size depends on.
+ */
+#define LABEL_SIZE_CACHE_MAX_ENTRIES 100000
+
+/* Fonts are interned, so that a key can hold a pointer to one and
+ * compare it by address. There are only ever a few of them.
+ */
+struct NautilusCanvasLabelFont {
+	PangoFontDescription *desc;
+	double resolution;
+	unsigned long options_hash;
+};
+
+typedef struct {
+	const NautilusCanvasLabelFont *font;
+	PangoAlignment alignment;
+	LabelMeasureParams params;
+	const char *text;
+} LabelSizeKey;
+
+typedef struct {
+	LabelSizeKey key; /* owns the text */
+	LabelSize size;
+	GList link;
+} LabelSizeCacheEntry;
+
+static GPtrArray *label_fonts;
+static GHashTable *label_size_cache;
+/* Most recently used first */
+static GQueue label_size_cache_lru = G_QUEUE_INIT;
+
+static guint
+label_size_key_hash (gconstpointer data)
+{
+	const LabelSizeKey *key;
+	guint hash;
+
+	key = data;
+
+	hash = g_str_hash (key->text);
+	hash = hash * 31 + GPOINTER_TO_UINT (key->font);
+	hash = hash * 31 + key->alignment;
+	hash = hash * 31 + key->params.max_text_width;
+	hash = hash * 31 + key->params.height_for_draw;
+	hash = hash * 31 + key->params.max_layout_lines;
+	hash = hash * 31 + (key->params.compact ? 1 : 0) + (key->params.for_layout ? 2 : 0);
+
+	return hash;
+}
+
+static gboolean
+label_size_key_equal (gconstpointer a,
+		      gconstpointer b)
+{
+	const LabelSizeKey *key_a, *key_b;
+
+	key_a = a;
+	key_b = b;
+
+	return key_a->font == key_b->font &&
+		key_a->alignment == key_b->alignment &&
+		key_a->params.max_text_width == key_b->params.max_text_width &&
+		key_a->params.compact == key_b->params.compact &&
+		key_a->params.height_for_draw == key_b->params.height_for_draw &&
+		key_a->params.for_layout == key_b->params.for_layout &&
+		key_a->params.max_layout_lines == key_b->params.max_layout_lines &&
+		strcmp (key_a->text, key_b->text) == 0;
+}
+
+static void
+label_size_cache_entry_free (LabelSizeCacheEntry *entry)
+{
+	g_free ((char *) entry->key.text);
+	g_slice_free (LabelSizeCacheEntry, entry);
+}
+
+static void
+label_font_free (NautilusCanvasLabelFont *font)
+{
+	pango_font_description_free (font->desc);
+	g_slice_free (NautilusCanvasLabelFont, font);
+}
+
+static void
+label_size_cache_free (void)
+{
+	GList *l;
+
+	for (l = label_size_cache_lru.head; l != NULL; ) {
+		LabelSizeCacheEntry *entry = l->data;
+		l = l->next;
+		label_size_cache_entry_free (entry);
+	}
+	g_queue_init (&label_size_cache_lru);
+
+	g_hash_table_destroy (label_size_cache);
+	label_size_cache = NULL;
+
+	g_ptr_array_unref (label_fonts);
+	label_fonts = NULL;
+}
+
+static void
+ensure_label_size_cache (void)
+{
+	if (label_size_cache == NULL) {
+		label_size_cache = g_hash_table_new (label_size_key_hash, label_size_key_equal);
+		label_fonts = g_ptr_array_new_with_free_func ((GDestroyNotify) label_font_free);
+		eel_debug_call_at_shutdown (label_size_cache_free);
+	}
+}
+
+/* Only looks the font up when the labels of @container were
+ * invalidated since the last time.
+ */
+static const NautilusCanvasLabelFont *
+get_label_font (NautilusCanvasContainer *container)
+{
+	NautilusCanvasLabelFont *font;
+	PangoContext *context;
+	PangoFontDescription *desc;
+	const cairo_font_options_t *options;
+	unsigned long options_hash;
+	double resolution;
+	guint i;
+
+	if (container->details->label_font != NULL) {
+		return container->details->label_font;
+	}
+
+	ensure_label_size_cache ();
+
+	context = gtk_widget_get_pango_context (GTK_WIDGET (container));
+	desc = create_label_font_description (container, context);
+	resolution = pango_cairo_context_get_resolution (context);
+	options = pango_cairo_context_get_font_options (context);
+	options_hash = options != NULL ? cairo_font_options_hash (options) : 0;
+
+	for (i = 0; i < label_fonts->len; i++) {
+		font = g_ptr_array_index (label_fonts, i);
+		if (font->resolution == resolution &&
+		    font->options_hash == options_hash &&
+		    pango_font_description_equal (font->desc, desc)) {
+			pango_font_description_free (desc);
+			container->details->label_font = font;
+			return font;
+		}
 	}
+
+	font = g_slice_new (NautilusCanvasLabelFont);
+	font->desc = desc;
+	font->resolution = resolution;
+	font->options_hash = options_hash;
+	g_ptr_array_add (label_fonts, font);
+
+	container->details->label_font = font;
+	return font;
+}
+
+static LabelSizeCacheEntry *
+label_size_cache_lookup (const LabelSizeKey *key)
+{
+	LabelSizeCacheEntry *entry;
+
+	ensure_label_size_cache ();
+
+	entry = g_hash_table_lookup (label_size_cache, key);
+	if (entry != NULL) {
+		g_queue_unlink (&label_size_cache_lru, &entry->link);
+		g_queue_push_head_link (&label_size_cache_lru, &entry->link);
+	}
+
+	return entry;
+}
+
+/* @key must not be in the cache yet. */
+static void
+label_size_cache_insert (const LabelSizeKey *key,
+			 const LabelSize *size)
+{
+	LabelSizeCacheEntry *entry;
+
+	entry = g_slice_new0 (LabelSizeCacheEntry);
+	entry->key = *key;
+	entry->key.text = g_strdup (key->text);
+	entry->size = *size;
+	entry->link.data = entry;
+
+	g_hash_table_insert (label_size_cache, &entry->key, entry);
+	g_queue_push_head_link (&label_size_cache_lru, &entry->link);
+
+	if (label_size_cache_lru.length > LABEL_SIZE_CACHE_MAX_ENTRIES) {
+		entry = label_size_cache_lru.tail->data;
+		g_queue_unlink (&label_size_cache_lru, &entry->link);
+		g_hash_table_remove (label_size_cache, &entry->key);
+		label_size_cache_entry_free (entry);
+	}
+}
+
+static void
+get_label_size_key (NautilusCanvasItem *item,
+		    gboolean for_layout,
+		    const char *text,
+		    LabelSizeKey *key)
+{
+	NautilusCanvasContainer *container;
+
+	container = NAUTILUS_CANVAS_CONTAINER (EEL_CANVAS_ITEM (item)->canvas);
+
+	key->font = get_label_font (container);
+	key->alignment = get_label_alignment (container);
+	get_label_measure_params (item, for_layout, &key->params);
+	key->text = text;
+}
+
+static void
+measure_label (NautilusCanvasItem *item,
+	       PangoLayout **layout_cache,
+	       const char *text,
+	       gboolean for_layout,
+	       LabelSize *size)
+{
+	LabelSizeKey key;
+	LabelSizeCacheEntry *entry;
+	PangoLayout *layout;
+
+	get_label_size_key (item, for_layout, text, &key);
+
+	entry = label_size_cache_lookup (&key);
+	if (entry != NULL) {
+		*size = entry->size;
+		return;
+	}
+
+	layout = get_label_layout (layout_cache, item, text);
+	measure_label_layout (layout, &key.params, size);
+	g_object_unref (layout);
+
+	label_size_cache_insert (&key, size);
+}
+
+/* Shaping is by far the most expensive part of laying out a large
+ * directory. When many labels have not been measured yet, they are
+ * shaped up front by a few threads, each with its own font map and
+ * context, which Pango supports since 1.32.6. Only the sizes cross
+ * threads; measure_label() then finds all of them in the cache.
+ */
+#define PARALLEL_MEASURE_MIN_JOBS 256
+#define PARALLEL_MEASURE_JOBS_PER_THREAD 128
+#define PARALLEL_MEASURE_MAX_THREADS 8
+
+#if PANGO_VERSION_CHECK (1, 32, 6)
+
+typedef struct {
+	LabelSizeKey key;
+	LabelSize size;
+} LabelMeasureJob;
+
+typedef struct {
+	GPtrArray *jobs;
+	volatile gint next_job;
+
+	PangoFontDescription *font_desc;
+	PangoAlignment alignment;
+	double resolution;
+	cairo_font_options_t *font_options;
+	PangoDirection base_dir;
+	PangoLanguage *language;
+} LabelMeasureBatch;
+
+static void
+add_label_measure_job (LabelMeasureBatch *batch,
+		       GHashTable *pending,
+		       NautilusCanvasItem *item,
+		       const char *text,
+		       gboolean for_layout)
+{
+	LabelMeasureJob *job;
+	LabelSizeKey key;
+
+	if (text == NULL || text[0] == '\0') {
+		return;
+	}
+
+	get_label_size_key (item, for_layout, text, &key);
+
+	if (g_hash_table_contains (pending, &key) ||
+	    g_hash_table_lookup (label_size_cache, &key) != NULL) {
+		return;
+	}
+
+	/* The text belongs to the item, which outlives the batch */
+	job = g_slice_new0 (LabelMeasureJob);
+	job->key = key;
+	g_hash_table_add (pending, &job->key);
+
+	g_ptr_array_add (batch->jobs, job);
+}
+
+static gpointer
+run_label_measure_jobs (gpointer data)
+{
+	LabelMeasureBatch *batch;
+	LabelMeasureJob *job;
+	PangoFontMap *font_map;
+	PangoContext *context;
+	PangoLayout *layout;
+	char *text;
+	guint i;
+
+	batch = data;
+
+	font_map = pango_cairo_font_map_new ();
+	context = pango_font_map_create_context (font_map);
+	pango_cairo_context_set_resolution (context, batch->resolution);
+	pango_cairo_context_set_font_options (context, batch->font_options);
+	pango_context_set_base_dir (context, batch->base_dir);
+	pango_context_set_language (context, batch->language);
+
+	layout = pango_layout_new (context);
+	setup_label_layout (layout, "", batch->alignment, batch->font_desc);
+
+	while ((i = g_atomic_int_add (&batch->next_job, 1)) < batch->jobs->len) {
+		job = g_ptr_array_index (batch->jobs, i);
+
+		text = zeroify_label_text (job->key.text);
+		pango_layout_set_text (layout, text, -1);
+		g_free (text);
+
+		measure_label_layout (layout, &job->key.params, &job->size);
+	}
+
+	g_object_unref (layout);
+	g_object_unref (context);
+	g_object_unref (font_map);
+
+	return NULL;
+}
+
+static int
+get_n_measure_threads (guint n_jobs)
+{
+	long n_processors;
+
+	if (pango_version () < PANGO_VERSION_ENCODE (1, 32, 6)) {
+		return 1;
+	}
+
+	n_processors = sysconf (_SC_NPROCESSORS_ONLN);
+	if (n_processors < 1) {
+		n_processors = 1;
+	}
+
+	return CLAMP (MIN (n_processors, (long) (n_jobs / PARALLEL_MEASURE_JOBS_PER_THREAD)),
+		      1, PARALLEL_MEASURE_MAX_THREADS);
+}
+
+#endif /* PANGO_VERSION_CHECK (1, 32, 6) */
+
+void
+nautilus_canvas_item_measure_labels (GPtrArray *items)
+{
+#if PANGO_VERSION_CHECK (1, 32, 6)
+	NautilusCanvasItem *item;
+	NautilusCanvasContainer *container;
+	LabelMeasureBatch batch;
+	LabelMeasureJob *job;
+	PangoContext *context;
+	GHashTable *pending;
+	GThread **threads;
+	int n_threads, i;
+	guint j;
+
+	if (items->len < PARALLEL_MEASURE_MIN_JOBS) {
+		return;
+	}
+
+	item = g_ptr_array_index (items, 0);
+	container = NAUTILUS_CANVAS_CONTAINER (EEL_CANVAS_ITEM (item)->canvas);
+
+	ensure_label_size_cache ();
+
+	memset (&batch, 0, sizeof (LabelMeasureBatch));
+	batch.jobs = g_ptr_array_new ();
+	pending = g_hash_table_new (label_size_key_hash, label_size_key_equal);
+
+	for (j = 0; j < items->len; j++) {
+		item = g_ptr_array_index (items, j);
+
+		if (item->details->text_width >= 0 && item->details->text_height >= 0) {
+			continue;
+		}
+
+		add_label_measure_job (&batch, pending, item, item->details->editable_text, TRUE);
+		add_label_measure_job (&batch, pending, item, item->details->additional_text, FALSE);
+	}
+
+	g_hash_table_destroy (pending);
+
+	n_threads = get_n_measure_threads (batch.jobs->len);
+
+	if (batch.jobs->len >= PARALLEL_MEASURE_MIN_JOBS && n_threads > 1) {
+		context = gtk_widget_get_pango_context (GTK_WIDGET (container));
+
+		batch.font_desc = create_label_font_description (container, context);
+		batch.alignment = get_label_alignment (container);
+		batch.resolution = pango_cairo_context_get_resolution (context);
+		batch.font_options = pango_cairo_context_get_font_options (context) != NULL ?
+			cairo_font_options_copy (pango_cairo_context_get_font_options (context)) :
+			cairo_font_options_create ();
+		batch.base_dir = pango_context_get_base_dir (context);
+		batch.language = pango_context_get_language (context);
+
+		/* The main thread takes its share of the jobs too */
+		threads = g_new0 (GThread *, n_threads - 1);
+		for (i = 0; i < n_threads - 1; i++) {
+			threads[i] = g_thread_new ("nautilus-measure-labels",
+						   run_label_measure_jobs, &batch);
+		}
+		run_label_measure_jobs (&batch);
+		for (i = 0; i < n_threads - 1; i++) {
+			g_thread_join (threads[i]);
+		}
+		g_free (threads);
+
+		DEBUG ("Measured %u labels in %d threads", batch.jobs->len, n_threads);
+
+		pango_font_description_free (batch.font_desc);
+		cairo_font_options_destroy (batch.font_options);
+
+		for (j = 0; j < batch.jobs->len; j++) {
+			job = g_ptr_array_index (batch.jobs, j);
+			label_size_cache_insert (&job->key, &job->size);
+		}
+	}
+
+	for (j = 0; j < batch.jobs->len; j++) {
+		job = g_ptr_array_index (batch.jobs, j);
+		g_slice_free (LabelMeasureJob, job);
+	}
+	g_ptr_array_free (batch.jobs, TRUE);
+#endif
 }
 
 static void
 measure_label_text (NautilusCanvasItem *item)
 {
 	NautilusCanvasItemDetails *details;
-	NautilusCanvasContainer *container;
 	gint editable_height, editable_height_for_layout, editable_height_for_entire_text, editable_width, editable_dx;
 	gint additional_height, additional_width, additional_dx;
-	PangoLayout *editable_layout;
-	PangoLayout *additional_layout;
+	LabelSize editable_size, additional_size;
 	gboolean have_editable, have_additional;
 
 	/* check to see if the cached values are still valid; if so, there's
@@ -931,50 +1454,28 @@ measure_label_text (NautilusCanvasItem *item)
 	return;
 #endif
 
-	editable_width = 0;
-	editable_height = 0;
-	editable_height_for_layout = 0;
-	editable_height_for_entire_text = 0;
-	editable_dx = 0;
-	additional_width = 0;
-	additional_height = 0;
-	additional_dx = 0;
-
-	container = NAUTILUS_CANVAS_CONTAINER (EEL_CANVAS_ITEM (item)->canvas);	
-	editable_layout = NULL;
-	additional_layout = NULL;
+	memset (&editable_size, 0, sizeof (LabelSize));
+	memset (&additional_size, 0, sizeof (LabelSize));
 
 	if (have_editable) {
-		/* first, measure required text height: editable_height_for_entire_text
-		 * then, measure text height applicable for layout: editable_height_for_layout
-		 * next, measure actually displayed height: editable_height
-		 */
-		editable_layout = get_label_layout (&details->editable_text_layout, item, details->editable_text);
-
-		prepare_pango_layout_for_measure_entire_text (item, editable_layout);
-		layout_get_full_size (editable_layout,
-				      NULL,
-				      &editable_height_for_entire_text,
-				      NULL);
-		layout_get_size_for_layout (editable_layout,
-					    nautilus_canvas_container_get_max_layout_lines (container),
-					    editable_height_for_entire_text,
-					    &editable_height_for_layout);
-
-		prepare_pango_layout_for_draw (item, editable_layout);
-		layout_get_full_size (editable_layout,
-				      &editable_width,
-				      &editable_height,
-				      &editable_dx);
+		measure_label (item, &details->editable_text_layout, details->editable_text,
+			       TRUE, &editable_size);
 	}
 
 	if (have_additional) {
-		additional_layout = get_label_layout (&details->additional_text_layout, item, details->additional_text);
-		prepare_pango_layout_for_draw (item, additional_layout);
-		layout_get_full_size (additional_layout,
-				      &additional_width, &additional_height, &additional_dx);
+		measure_label (item, &details->additional_text_layout, details->additional_text,
+			       FALSE, &additional_size);
 	}
 
+	editable_width = editable_size.width;
+	editable_height = editable_size.height;
+	editable_height_for_layout = editable_size.height_for_layout;
+	editable_height_for_entire_text = editable_size.height_for_entire_text;
+	editable_dx = editable_size.dx;
+	additional_width = additional_size.width;
+	additional_height = additional_size.height;
+	additional_dx = additional_size.dx;
+
 	details->editable_text_height = editable_height;
 
 	if (editable_width > additional_width) {
@@ -1005,14 +1506,6 @@ measure_label_text (NautilusCanvasItem *item)
 
 	/* extra to make it look nicer */
 	details->text_width += TEXT_BACK_PADDING_X*2;
-
-	if (editable_layout) {
-		g_object_unref (editable_layout);
-	}
-
-	if (additional_layout) {
-		g_object_unref (additional_layout);
-	}
 }
 
 static void
@@ -1305,21 +1798,16 @@ static GdkPixbuf *
 real_map_pixbuf (NautilusCanvasItem *canvas_item)
 {
 	EelCanvas *canvas;
-	GdkPixbuf *temp_pixbuf, *old_pixbuf;
 	GtkStyleContext *style;
 	GdkRGBA color;
+	NautilusIconEffects effects;
 	
-	temp_pixbuf = canvas_item->details->pixbuf;
 	canvas = EEL_CANVAS_ITEM(canvas_item)->canvas;
-
-	g_object_ref (temp_pixbuf);
+	effects = 0;
 
 	if (canvas_item->details->is_prelit ||
 	    canvas_item->details->is_highlighted_for_clipboard) {
-		old_pixbuf = temp_pixbuf;
-
-		temp_pixbuf = eel_create_spotlight_pixbuf (temp_pixbuf);
-		g_object_unref (old_pixbuf);
+		effects |= NAUTILUS_ICON_EFFECT_SPOTLIGHT;
 	}
 
 	if (canvas_item->details->is_highlighted_for_selection
@@ -1332,13 +1820,10 @@ real_map_pixbuf (NautilusCanvasItem *canvas_item)
 			gtk_style_context_get_background_color (style, GTK_STATE_FLAG_ACTIVE, &color);	
 		}
 
-		old_pixbuf = temp_pixbuf;
-		temp_pixbuf = eel_create_colorized_pixbuf (temp_pixbuf, &color);
-
-		g_object_unref (old_pixbuf);
+		effects |= NAUTILUS_ICON_EFFECT_COLORIZE;
 	}
 	
-	return temp_pixbuf;
+	return nautilus_icon_effects_apply (canvas_item->details->pixbuf, effects, &color);
 }
 
 static GdkPixbuf *
@@ -1476,73 +1961,105 @@ nautilus_canvas_item_draw (EelCanvasItem *item,
 	  g_ascii_isdigit (*(p+2))))
 
 
-static PangoLayout *
-create_label_layout (NautilusCanvasItem *item,
-		     const char *text)
+static PangoAlignment
+get_label_alignment (NautilusCanvasContainer *container)
+{
+	if (container->details->label_position == NAUTILUS_CANVAS_LABEL_POSITION_BESIDE) {
+		if (!nautilus_canvas_container_is_layout_rtl (container)) {
+			return PANGO_ALIGN_LEFT;
+		} else {
+			return PANGO_ALIGN_RIGHT;
+		}
+	}
+
+	return PANGO_ALIGN_CENTER;
+}
+
+static PangoFontDescription *
+create_label_font_description (NautilusCanvasContainer *container,
+			       PangoContext *context)
 {
-	PangoLayout *layout;
-	PangoContext *context;
 	PangoFontDescription *desc;
-	NautilusCanvasContainer *container;
-	EelCanvasItem *canvas_item;
+
+	if (container->details->font) {
+		desc = pango_font_description_from_string (container->details->font);
+	} else {
+		desc = pango_font_description_copy (pango_context_get_font_description (context));
+		pango_font_description_set_size (desc,
+						 pango_font_description_get_size (desc) +
+						 container->details->font_size_table [container->details->zoom_level]);
+	}
+
+	return desc;
+}
+
+static char *
+zeroify_label_text (const char *text)
+{
 	GString *str;
-	char *zeroified_text;
 	const char *p;
 
-	canvas_item = EEL_CANVAS_ITEM (item);
-
-	container = NAUTILUS_CANVAS_CONTAINER (canvas_item->canvas);
-	context = gtk_widget_get_pango_context (GTK_WIDGET (canvas_item->canvas));
-	layout = pango_layout_new (context);
-	
-	zeroified_text = NULL;
+	if (text == NULL) {
+		return NULL;
+	}
 
-	if (text != NULL) {
-		str = g_string_new (NULL);
+	str = g_string_new (NULL);
 
-		for (p = text; *p != '\0'; p++) {
-			str = g_string_append_c (str, *p);
+	for (p = text; *p != '\0'; p++) {
+		str = g_string_append_c (str, *p);
 
-			if (*p == '_' || *p == '-' || (*p == '.' && ZERO_OR_THREE_DIGITS (p+1))) {
-				/* Ensure that we allow to break after '_' or '.' characters,
-				 * if they are not likely to be part of a version information, to
-				 * not break wrapping of foobar-0.0.1.
-				 * Wrap before IPs and long numbers, though. */
-				str = g_string_append (str, ZERO_WIDTH_SPACE);
-			}
+		if (*p == '_' || *p == '-' || (*p == '.' && ZERO_OR_THREE_DIGITS (p+1))) {
+			/* Ensure that we allow to break after '_' or '.' characters,
+			 * if they are not likely to be part of a version information, to
+			 * not break wrapping of foobar-0.0.1.
+			 * Wrap before IPs and long numbers, though. */
+			str = g_string_append (str, ZERO_WIDTH_SPACE);
 		}
-
-		zeroified_text = g_string_free (str, FALSE);
 	}
 
+	return g_string_free (str, FALSE);
+}
+
+static void
+setup_label_layout (PangoLayout *layout,
+		    const char *text,
+		    PangoAlignment alignment,
+		    const PangoFontDescription *desc)
+{
+	char *zeroified_text;
+
+	zeroified_text = zeroify_label_text (text);
 	pango_layout_set_text (layout, zeroified_text, -1);
+	g_free (zeroified_text);
+
 	pango_layout_set_auto_dir (layout, FALSE);
-	
-	if (container->details->label_position == NAUTILUS_CANVAS_LABEL_POSITION_BESIDE) {
-		if (!nautilus_canvas_container_is_layout_rtl (container)) {
-			pango_layout_set_alignment (layout, PANGO_ALIGN_LEFT);
-		} else {
-			pango_layout_set_alignment (layout, PANGO_ALIGN_RIGHT);
-		}
-	} else {
-		pango_layout_set_alignment (layout, PANGO_ALIGN_CENTER);
-	}
+	pango_layout_set_alignment (layout, alignment);
 
 	pango_layout_set_spacing (layout, LABEL_LINE_SPACING);
 	pango_layout_set_wrap (layout, PANGO_WRAP_WORD_CHAR);
 
-	/* Create a font description */
-	if (container->details->font) {
-		desc = pango_font_description_from_string (container->details->font);
-	} else {
-		desc = pango_font_description_copy (pango_context_get_font_description (context));
-		pango_font_description_set_size (desc,
-						 pango_font_description_get_size (desc) +
-						 container->details->font_size_table [container->details->zoom_level]);
-	}
 	pango_layout_set_font_description (layout, desc);
+}
+
+static PangoLayout *
+create_label_layout (NautilusCanvasItem *item,
+		     const char *text)
+{
+	PangoLayout *layout;
+	PangoContext *context;
+	PangoFontDescription *desc;
+	NautilusCanvasContainer *container;
+	EelCanvasItem *canvas_item;
+
+	canvas_item = EEL_CANVAS_ITEM (item);
+
+	container = NAUTILUS_CANVAS_CONTAINER (canvas_item->canvas);
+	context = gtk_widget_get_pango_context (GTK_WIDGET (canvas_item->canvas));
+	layout = pango_layout_new (context);
+
+	desc = create_label_font_description (container, context);
+	setup_label_layout (layout, text, get_label_alignment (container), desc);
 	pango_font_description_free (desc);
-	g_free (zeroified_text);
 	
 	return layout;
 }
@@ -95,6 +95,7 @@ gboolean    nautilus_canvas_item_hit_test_stretch_handles (NautilusCanvasItem
 							   GtkCornerType            *corner);
 void        nautilus_canvas_item_invalidate_label         (NautilusCanvasItem       *item);
 void        nautilus_canvas_item_invalidate_label_size    (NautilusCanvasItem       *item);
+void        nautilus_canvas_item_measure_labels           (GPtrArray                *items);
 EelDRect    nautilus_canvas_item_get_icon_rectangle     (const NautilusCanvasItem *item);
 EelDRect    nautilus_canvas_item_get_text_rectangle       (NautilusCanvasItem       *item,
 							   gboolean                  for_layout);
@@ -118,6 +118,9 @@ enum {
 	LAST_LABEL_COLOR
 };
 
+/* The font labels are measured with, see nautilus-canvas-item.c */
+typedef struct NautilusCanvasLabelFont NautilusCanvasLabelFont;
+
 struct NautilusCanvasContainerDetails {
 	/* List of icons. */
 	GList *icons;
@@ -203,6 +206,11 @@ struct NautilusCanvasContainerDetails {
 	/* font sizes used to draw labels */
 	int font_size_table[NAUTILUS_ZOOM_LEVEL_LARGEST + 1];
 
+	/* The interned font of the labels, looked up again once the
+	 * labels are invalidated.
+	 */
+	const NautilusCanvasLabelFont *label_font;
+
 	/* State used so arrow keys don't wander if icons aren't lined up.
 	 */
 	int arrow_key_start_x;
@@ -26,6 +26,7 @@
 
 #include "nautilus-directory-notify.h"
 #include "nautilus-directory-private.h"
+#include "nautilus-directory-snapshot.h"
 #include "nautilus-file-attributes.h"
 #include "nautilus-file-private.h"
 #include "nautilus-file-utilities.h"
@@ -56,6 +57,15 @@
 
 #define DIRECTORY_LOAD_ITEMS_PER_CALLBACK 100
 
+/* When loading a file list the batch size starts at the above and is
+ * doubled or halved depending on how long each batch takes to arrive,
+ * within limits that depend on whether the directory is local.
+ */
+#define DIRECTORY_LOAD_MIN_ITEMS_PER_CALLBACK 25
+#define DIRECTORY_LOAD_MAX_ITEMS_PER_CALLBACK_LOCAL 5000
+#define DIRECTORY_LOAD_MAX_ITEMS_PER_CALLBACK_REMOTE 400
+#define DIRECTORY_LOAD_BATCH_TARGET_USEC (40 * 1000)
+
 /* Keep async. jobs down to this number for all directories. */
 #define MAX_ASYNC_JOBS 10
 
@@ -78,6 +88,11 @@ struct ThumbnailState {
 	NautilusFile *file;
 	gboolean trying_original;
 	gboolean tried_original;
+
+	/* Only these are used by the loading thread */
+	GFile *original;
+	char *thumbnail_path;
+	int max_thumbnail_size;
 };
 
 struct MountState {
@@ -99,6 +114,11 @@ struct DirectoryLoadState {
 	GHashTable *load_mime_list_hash;
 	NautilusFile *load_directory_file;
 	int load_file_count;
+	int items_per_callback;
+	int max_items_per_callback;
+	gint64 batch_start_time;
+	gboolean got_snapshot_key;
+	NautilusDirectorySnapshotKey snapshot_key;
 };
 
 struct MimeListState {
@@ -924,7 +944,10 @@ dequeue_pending_idle_callback (gpointer callback_data)
 
 			/* Add the MIME type to the set. */
 			mimetype = g_file_info_get_content_type (file_info);
-			if (mimetype != NULL) {
+			if (mimetype != NULL &&
+			    g_hash_table_lookup (dir_load_state->load_mime_list_hash,
+						 mimetype) == NULL) {
+				nautilus_prefetch_content_type_description (mimetype);
 				istr_set_insert (dir_load_state->load_mime_list_hash,
 						 mimetype);
 			}
@@ -936,6 +959,7 @@ dequeue_pending_idle_callback (gpointer callback_data)
 			/* file already exists in dir, check if we still need to
 			 *  emit file_added or if it changed */
 			set_file_unconfirmed (file, FALSE);
+			file->details->from_snapshot = FALSE;
 			if (!file->details->is_added) {
 				/* We consider this newly added even if its in the list.
 				 * This can happen if someone called nautilus_file_get_by_uri()
@@ -1099,14 +1123,36 @@ static void
 directory_load_done (NautilusDirectory *directory,
 		     GError *error)
 {
-	GList *node;
+	DirectoryLoadState *state;
+	NautilusFile *file;
+	GList *node, *next, *gone_files;
 
 	nautilus_profile_start (NULL);
 
+	state = directory->details->directory_load_in_progress;
+
 	directory->details->directory_loaded = TRUE;
 	directory->details->directory_loaded_sent_notification = FALSE;
 
 	if (error != NULL) {
+		/* The files that only came from the snapshot were never
+		 * seen on disk, so they are not kept around.
+		 */
+		gone_files = NULL;
+		for (node = directory->details->file_list;
+		     node != NULL; node = next) {
+			file = NAUTILUS_FILE (node->data);
+			next = node->next;
+
+			if (file->details->from_snapshot) {
+				nautilus_file_ref (file);
+				gone_files = g_list_prepend (gone_files, file);
+				nautilus_file_mark_gone (file);
+			}
+		}
+		nautilus_directory_emit_change_signals (directory, gone_files);
+		nautilus_file_list_free (gone_files);
+
 		/* The load did not complete successfully. This means
 		 * we don't know the status of the files in this directory.
 		 * We clear the unconfirmed bit on each file here so that
@@ -1127,6 +1173,14 @@ directory_load_done (NautilusDirectory *directory,
 	}
 	dequeue_pending_idle_callback (directory);
 
+	if (error == NULL &&
+	    state != NULL && state->got_snapshot_key &&
+	    nautilus_directory_is_file_list_monitored (directory) &&
+	    directory->details->confirmed_file_count >= NAUTILUS_DIRECTORY_SNAPSHOT_MIN_FILES &&
+	    nautilus_directory_snapshot_is_enabled (directory)) {
+		nautilus_directory_snapshot_save (directory, &state->snapshot_key);
+	}
+
 	directory_load_cancel (directory);
 
 	nautilus_profile_end (NULL);
@@ -2074,6 +2128,46 @@ directory_load_state_free (DirectoryLoadState *state)
 	g_free (state);
 }
 
+static void more_files_callback (GObject *source_object,
+				 GAsyncResult *res,
+				 gpointer user_data);
+
+static void
+directory_load_next_files (DirectoryLoadState *state)
+{
+	state->batch_start_time = g_get_monotonic_time ();
+	g_file_enumerator_next_files_async (state->enumerator,
+					    state->items_per_callback,
+					    G_PRIORITY_DEFAULT,
+					    state->cancellable,
+					    more_files_callback,
+					    state);
+}
+
+static void
+directory_load_adjust_batch_size (DirectoryLoadState *state,
+				  int n_files)
+{
+	gint64 elapsed;
+
+	elapsed = g_get_monotonic_time () - state->batch_start_time;
+	nautilus_profile_msg ("batch of %d files (asked %d) in %" G_GINT64_FORMAT " us",
+			      n_files, state->items_per_callback, elapsed);
+
+	/* A short batch means we reached the end, nothing to learn. */
+	if (n_files < state->items_per_callback) {
+		return;
+	}
+
+	if (elapsed < DIRECTORY_LOAD_BATCH_TARGET_USEC / 2) {
+		state->items_per_callback = MIN (state->items_per_callback * 2,
+						 state->max_items_per_callback);
+	} else if (elapsed > DIRECTORY_LOAD_BATCH_TARGET_USEC * 2) {
+		state->items_per_callback = MAX (state->items_per_callback / 2,
+						 DIRECTORY_LOAD_MIN_ITEMS_PER_CALLBACK);
+	}
+}
+
 static void
 more_files_callback (GObject *source_object,
 		     GAsyncResult *res,
@@ -2102,6 +2196,8 @@ more_files_callback (GObject *source_object,
 	files = g_file_enumerator_next_files_finish (state->enumerator,
 						     res, &error);
 
+	directory_load_adjust_batch_size (state, g_list_length (files));
+
 	for (l = files; l != NULL; l = l->next) {
 		info = l->data;
 		directory_load_one (directory, info);
@@ -2112,12 +2208,7 @@ more_files_callback (GObject *source_object,
 		directory_load_done (directory, error);
 		directory_load_state_free (state);
 	} else {
-		g_file_enumerator_next_files_async (state->enumerator,
-						    DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-						    G_PRIORITY_DEFAULT,
-						    state->cancellable,
-						    more_files_callback,
-						    state);
+		directory_load_next_files (state);
 	}
 
 	nautilus_directory_unref (directory);
@@ -2157,15 +2248,111 @@ enumerate_children_callback (GObject *source_object,
 		return;
 	} else {
 		state->enumerator = enumerator;
-		g_file_enumerator_next_files_async (state->enumerator,
-						    DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-						    G_PRIORITY_DEFAULT,
-						    state->cancellable,
-						    more_files_callback,
-						    state);
+		directory_load_next_files (state);
+	}
+}
+
+
+static void
+snapshot_load_callback (GObject *source_object,
+			GAsyncResult *res,
+			gpointer user_data)
+{
+	NautilusDirectory *directory;
+	NautilusFile *file;
+	GFileInfo *info;
+	GList *infos, *node, *added_files;
+
+	directory = NAUTILUS_DIRECTORY (user_data);
+	infos = nautilus_directory_snapshot_load_finish (G_FILE (source_object), res);
+
+	/* Once the real load is done the snapshot has nothing to add. */
+	if (infos != NULL &&
+	    directory->details->directory_load_in_progress != NULL &&
+	    !directory->details->directory_loaded) {
+		nautilus_profile_start ("nitems %d", g_list_length (infos));
+
+		added_files = NULL;
+		for (node = infos; node != NULL; node = node->next) {
+			info = node->data;
+
+			if (nautilus_directory_find_file_by_name (directory,
+								  g_file_info_get_name (info)) != NULL) {
+				continue;
+			}
+
+			file = nautilus_file_new_from_info (directory, info);
+			nautilus_directory_add_file (directory, file);
+			/* The enumeration confirms the file when it sees it,
+			 * when it's done the ones it didn't see are marked gone.
+			 */
+			set_file_unconfirmed (file, TRUE);
+			file->details->is_added = TRUE;
+			/* The info stays marked up to date so that the file
+			 * can be shown right away; the enumeration replaces
+			 * it when it gets to the file, and until then
+			 * from_snapshot tells it is only what was saved.
+			 */
+			file->details->from_snapshot = TRUE;
+			added_files = g_list_prepend (added_files, file);
+		}
+
+		nautilus_directory_emit_files_added (directory, added_files);
+		nautilus_file_list_free (added_files);
+
+		nautilus_profile_end (NULL);
 	}
+
+	g_list_free_full (infos, g_object_unref);
+	nautilus_directory_unref (directory);
+}
+
+static void
+directory_load_enumerate (DirectoryLoadState *state)
+{
+	g_file_enumerate_children_async (state->directory->details->location,
+					 NAUTILUS_FILE_DEFAULT_ATTRIBUTES,
+					 0, /* flags */
+					 G_PRIORITY_DEFAULT, /* prio */
+					 state->cancellable,
+					 enumerate_children_callback,
+					 state);
 }
 
+static void
+snapshot_key_callback (GObject *source_object,
+		       GAsyncResult *res,
+		       gpointer user_data)
+{
+	DirectoryLoadState *state;
+	GFileInfo *info;
+
+	state = user_data;
+
+	if (state->directory == NULL) {
+		/* Operation was cancelled. Bail out */
+		directory_load_state_free (state);
+		return;
+	}
+
+	/* Without a key there is no snapshot to show or to save; the
+	 * enumeration still reports why the directory can't be read.
+	 */
+	info = g_file_query_info_finish (G_FILE (source_object), res, NULL);
+	if (info != NULL) {
+		nautilus_directory_snapshot_key_from_info (info, &state->snapshot_key);
+		state->got_snapshot_key = TRUE;
+		g_object_unref (info);
+
+		nautilus_directory_snapshot_load_async (state->directory->details->location,
+							&state->snapshot_key,
+							state->cancellable,
+							snapshot_load_callback,
+							nautilus_directory_ref (state->directory));
+	}
+
+	directory_load_enumerate (state);
+}
 
 /* Start monitoring the file list if it isn't already. */
 static void
@@ -2195,6 +2382,10 @@ start_monitoring_file_list (NautilusDirectory *directory)
 	state->cancellable = g_cancellable_new ();
 	state->load_mime_list_hash = istr_set_new ();
 	state->load_file_count = 0;
+	state->items_per_callback = DIRECTORY_LOAD_ITEMS_PER_CALLBACK;
+	state->max_items_per_callback = nautilus_directory_is_local (directory) ?
+		DIRECTORY_LOAD_MAX_ITEMS_PER_CALLBACK_LOCAL :
+		DIRECTORY_LOAD_MAX_ITEMS_PER_CALLBACK_REMOTE;
 	
 	g_assert (directory->details->location != NULL);
         state->load_directory_file =
@@ -2223,14 +2414,22 @@ start_monitoring_file_list (NautilusDirectory *directory)
 #endif
 	
 	directory->details->directory_load_in_progress = state;
-	
-	g_file_enumerate_children_async (directory->details->location,
-					 NAUTILUS_FILE_DEFAULT_ATTRIBUTES,
+
+	if (nautilus_directory_snapshot_is_enabled (directory)) {
+		/* The key is read before the enumeration starts, so a
+		 * change made during the load leaves the saved snapshot
+		 * with an older key instead of a newer key on a stale list.
+		 */
+		g_file_query_info_async (directory->details->location,
+					 NAUTILUS_DIRECTORY_SNAPSHOT_KEY_ATTRIBUTES,
 					 0, /* flags */
 					 G_PRIORITY_DEFAULT, /* prio */
 					 state->cancellable,
-					 enumerate_children_callback,
+					 snapshot_key_callback,
 					 state);
+	} else {
+		directory_load_enumerate (state);
+	}
 }
 
 /* Stop monitoring the file list if it is being monitored. */
@@ -3449,6 +3648,7 @@ query_info_callback (GObject *source_object,
 		get_info_file->details->get_info_failed = TRUE;
 		get_info_file->details->get_info_error = error;
 	} else {
+		get_info_file->details->from_snapshot = FALSE;
 		nautilus_file_update_info (get_info_file, info);
 		g_object_unref (info);
 	}
@@ -3845,6 +4045,10 @@ static void
 thumbnail_state_free (ThumbnailState *state)
 {
 	g_object_unref (state->cancellable);
+	if (state->original != NULL) {
+		g_object_unref (state->original);
+	}
+	g_free (state->thumbnail_path);
 	g_free (state);
 }
 
@@ -3862,8 +4066,7 @@ thumbnail_loader_size_prepared (GdkPixbufLoader *loader,
 
 	aspect_ratio = ((double) width) / height;
 
-	/* cf. nautilus_file_get_icon() */
-	max_thumbnail_size = NAUTILUS_ICON_SIZE_LARGEST * cached_thumbnail_size / NAUTILUS_ICON_SIZE_STANDARD;
+	max_thumbnail_size = GPOINTER_TO_INT (user_data);
 	if (MAX (width, height) > max_thumbnail_size) {
 		if (width > height) {
 			width = max_thumbnail_size;
@@ -3877,33 +4080,62 @@ thumbnail_loader_size_prepared (GdkPixbufLoader *loader,
 	}
 }
 
+#define THUMBNAIL_READ_CHUNK_SIZE 65536
+
+/* Feeds the file to the loader as it is read, so that it never is in
+ * memory as a whole, and large images get scaled while they are being
+ * decoded. Runs in a thread.
+ */
 static GdkPixbuf *
-get_pixbuf_for_content (goffset file_len,
-			char *file_contents)
+load_thumbnail_pixbuf (GFile *location,
+		       int max_thumbnail_size,
+		       GCancellable *cancellable)
 {
 	gboolean res;
 	GdkPixbuf *pixbuf, *pixbuf2;
 	GdkPixbufLoader *loader;
-	gsize chunk_len;
+	GFileInputStream *stream;
+	guchar *buffer;
+	gssize bytes_read;
+
+	stream = g_file_read (location, cancellable, NULL);
+	if (stream == NULL) {
+		return NULL;
+	}
+
 	pixbuf = NULL;
-	
+
 	loader = gdk_pixbuf_loader_new ();
 	g_signal_connect (loader, "size-prepared",
 			  G_CALLBACK (thumbnail_loader_size_prepared),
-			  NULL);
+			  GINT_TO_POINTER (max_thumbnail_size));
+
+	buffer = g_malloc (THUMBNAIL_READ_CHUNK_SIZE);
 
-	/* For some reason we have to write in chunks, or gdk-pixbuf fails */
+	/* Stop at the first chunk the loader rejects, the rest of a
+	 * broken or unknown file is not worth reading.
+	 */
 	res = TRUE;
-	while (res && file_len > 0) {
-		chunk_len = file_len;
-		res = gdk_pixbuf_loader_write (loader, (guchar *) file_contents, chunk_len, NULL);
-		file_contents += chunk_len;
-		file_len -= chunk_len;
+	while (res) {
+		bytes_read = g_input_stream_read (G_INPUT_STREAM (stream),
+						  buffer, THUMBNAIL_READ_CHUNK_SIZE,
+						  cancellable, NULL);
+		if (bytes_read <= 0) {
+			res = bytes_read == 0;
+			break;
+		}
+		res = gdk_pixbuf_loader_write (loader, buffer, bytes_read, NULL);
 	}
-	if (res) {
-		res = gdk_pixbuf_loader_close (loader, NULL);
+
+	g_free (buffer);
+	g_input_stream_close (G_INPUT_STREAM (stream), NULL, NULL);
+	g_object_unref (stream);
+
+	/* The loader has to be closed even when giving up on it */
+	if (!gdk_pixbuf_loader_close (loader, NULL)) {
+		res = FALSE;
 	}
-	if (res) {
+	if (res && gdk_pixbuf_loader_get_pixbuf (loader) != NULL) {
 		pixbuf = g_object_ref (gdk_pixbuf_loader_get_pixbuf (loader));
 	}
 	g_object_unref (G_OBJECT (loader));
@@ -3916,19 +4148,46 @@ get_pixbuf_for_content (goffset file_len,
 	return pixbuf;
 }
 
+static void
+thumbnail_load_thread (GSimpleAsyncResult *res,
+		       GObject *object,
+		       GCancellable *cancellable)
+{
+	ThumbnailState *state;
+	GFile *location;
+	GdkPixbuf *pixbuf;
+
+	state = g_async_result_get_user_data (G_ASYNC_RESULT (res));
+
+	pixbuf = NULL;
+	if (state->trying_original) {
+		pixbuf = load_thumbnail_pixbuf (state->original,
+						state->max_thumbnail_size,
+						cancellable);
+	}
+
+	if (pixbuf == NULL && state->thumbnail_path != NULL &&
+	    !g_cancellable_is_cancelled (cancellable)) {
+		location = g_file_new_for_path (state->thumbnail_path);
+		pixbuf = load_thumbnail_pixbuf (location,
+						state->max_thumbnail_size,
+						cancellable);
+		g_object_unref (location);
+	}
+
+	if (pixbuf != NULL) {
+		g_simple_async_result_set_op_res_gpointer (res, pixbuf, g_object_unref);
+	}
+}
 
 static void
-thumbnail_read_callback (GObject *source_object,
+thumbnail_load_callback (GObject *source_object,
 			 GAsyncResult *res,
 			 gpointer user_data)
 {
 	ThumbnailState *state;
-	gsize file_size;
-	char *file_contents;
-	gboolean result;
 	NautilusDirectory *directory;
 	GdkPixbuf *pixbuf;
-	GFile *location;
 
 	state = user_data;
 
@@ -3940,34 +4199,17 @@ thumbnail_read_callback (GObject *source_object,
 
 	directory = nautilus_directory_ref (state->directory);
 
-	result = g_file_load_contents_finish (G_FILE (source_object),
-					      res,
-					      &file_contents, &file_size,
-					      NULL, NULL);
-
-	pixbuf = NULL;
-	if (result) {
-		pixbuf = get_pixbuf_for_content (file_size, file_contents);
-		g_free (file_contents);
+	pixbuf = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (res));
+	if (pixbuf != NULL) {
+		g_object_ref (pixbuf);
 	}
-	
-	if (pixbuf == NULL && state->trying_original) {
-		state->trying_original = FALSE;
 
-		location = g_file_new_for_path (state->file->details->thumbnail_path);
-		g_file_load_contents_async (location,
-					    state->cancellable,
-					    thumbnail_read_callback,
-					    state);
-		g_object_unref (location);
-	} else {
-		state->directory->details->thumbnail_state = NULL;
-		async_job_end (state->directory, "thumbnail");
+	state->directory->details->thumbnail_state = NULL;
+	async_job_end (state->directory, "thumbnail");
 		
-		thumbnail_got_pixbuf (state->directory, state->file, pixbuf, state->tried_original);
+	thumbnail_got_pixbuf (state->directory, state->file, pixbuf, state->tried_original);
 	
-		thumbnail_state_free (state);
-	}
+	thumbnail_state_free (state);
 	
 	nautilus_directory_unref (directory);
 }
@@ -3979,6 +4221,7 @@ thumbnail_start (NautilusDirectory *directory,
 {
 	GFile *location;
 	ThumbnailState *state;
+	GSimpleAsyncResult *res;
 
 	if (directory->details->thumbnail_state != NULL) {
 		*doing_io = TRUE;
@@ -4000,21 +4243,29 @@ thumbnail_start (NautilusDirectory *directory,
 	state->directory = directory;
 	state->file = file;
 	state->cancellable = g_cancellable_new ();
+	state->thumbnail_path = g_strdup (file->details->thumbnail_path);
+	/* cf. nautilus_file_get_icon(); the preference may change while
+	 * the thread runs, so it gets the size as it is now.
+	 */
+	state->max_thumbnail_size = NAUTILUS_ICON_SIZE_LARGEST * cached_thumbnail_size / NAUTILUS_ICON_SIZE_STANDARD;
 
 	if (file->details->thumbnail_wants_original) {
 		state->tried_original = TRUE;
 		state->trying_original = TRUE;
-		location = nautilus_file_get_location (file);
+		state->original = nautilus_file_get_location (file);
+		location = g_object_ref (state->original);
 	} else {
 		location = g_file_new_for_path (file->details->thumbnail_path);
 	}
 	
 	directory->details->thumbnail_state = state;
 
-	g_file_load_contents_async (location,
-				    state->cancellable,
-				    thumbnail_read_callback,
-				    state);
+	res = g_simple_async_result_new (G_OBJECT (location),
+					 thumbnail_load_callback, state,
+					 thumbnail_start);
+	g_simple_async_result_run_in_thread (res, thumbnail_load_thread,
+					     G_PRIORITY_DEFAULT, state->cancellable);
+	g_object_unref (res);
 	g_object_unref (location);
 }
 
@@ -4591,6 +4842,10 @@ nautilus_directory_async_state_changed (NautilusDirectory *directory)
 	 * is not longer needed once the callbacks are satisfied.
 	 */
 
+	if (directory->details->async_state_freeze_count > 0) {
+		return;
+	}
+
 	if (directory->details->in_async_service_loop) {
 		directory->details->state_changed = TRUE;
 		return;
@@ -4611,6 +4866,26 @@ nautilus_directory_async_state_changed (NautilusDirectory *directory)
 	async_job_wake_up ();
 }
 
+/* Defers the work nautilus_directory_async_state_changed() does until
+ * the matching thaw, so that adding or removing many monitors on the
+ * files of a directory only starts and stops I/O once.
+ */
+void
+nautilus_directory_freeze_async_state (NautilusDirectory *directory)
+{
+	directory->details->async_state_freeze_count++;
+}
+
+void
+nautilus_directory_thaw_async_state (NautilusDirectory *directory)
+{
+	g_assert (directory->details->async_state_freeze_count > 0);
+
+	if (--directory->details->async_state_freeze_count == 0) {
+		nautilus_directory_async_state_changed (directory);
+	}
+}
+
 void
 nautilus_directory_cancel (NautilusDirectory *directory)
 {
@@ -43,6 +43,7 @@ typedef struct MimeListState MimeListState;
 typedef struct ThumbnailState ThumbnailState;
 typedef struct MountState MountState;
 typedef struct FilesystemInfoState FilesystemInfoState;
+typedef struct DirectoryNode DirectoryNode;
 
 typedef enum {
 	REQUEST_LINK_INFO,
@@ -72,6 +73,11 @@ struct NautilusDirectoryDetails
 	/* The location. */
 	GFile *location;
 
+	/* Our node in the URI component index, NULL if the location
+	 * can't be indexed.
+	 */
+	DirectoryNode *index_node;
+
 	/* The file objects. */
 	NautilusFile *as_file;
 	GList *file_list;
@@ -96,6 +102,7 @@ struct NautilusDirectoryDetails
 
 	gboolean in_async_service_loop;
 	gboolean state_changed;
+	int async_state_freeze_count;
 
 	gboolean file_list_monitored;
 	gboolean directory_loaded;
@@ -142,6 +149,8 @@ NautilusDirectory *nautilus_directory_get_existing                    (GFile
 
 /* async. interface */
 void               nautilus_directory_async_state_changed             (NautilusDirectory         *directory);
+void               nautilus_directory_freeze_async_state              (NautilusDirectory         *directory);
+void               nautilus_directory_thaw_async_state                (NautilusDirectory         *directory);
 void               nautilus_directory_call_when_ready_internal        (NautilusDirectory         *directory,
 								       NautilusFile              *file,
 								       NautilusFileAttributes     file_attributes,
@@ -201,6 +210,9 @@ void               nautilus_directory_emit_load_error                 (NautilusD
 								       GError                    *error);
 NautilusDirectory *nautilus_directory_get_internal                    (GFile                     *location,
 								       gboolean                   create);
+NautilusDirectory *nautilus_directory_get_existing_parent_by_uri      (const char                *uri,
+								       char                     **basename);
+void               nautilus_directory_drop_warm_directories           (void);
 char *             nautilus_directory_get_name_for_self_as_new_file   (NautilusDirectory         *directory);
 Request            nautilus_directory_set_up_request                  (NautilusFileAttributes     file_attributes);
 
@@ -0,0 +1,441 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-directory-snapshot.c: On-disk snapshots of directory file lists.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+/* A snapshot is a GVariant holding the file list of a directory as
+ * it was after a complete load, keyed by the modification time and
+ * inode of the directory. When a large directory is opened again and
+ * neither changed, the files in the snapshot are shown right away and
+ * the normal enumeration then confirms, updates or removes them.
+ *
+ * The cache keeps at most SNAPSHOT_MAX_FILES snapshots and
+ * SNAPSHOT_MAX_SIZE bytes; each snapshot that is used is touched, and
+ * the ones used least recently go first when it is over.
+ */
+
+#include <config.h>
+#include "nautilus-directory-snapshot.h"
+
+#include "nautilus-directory-private.h"
+#include "nautilus-file-private.h"
+#include "nautilus-global-preferences.h"
+
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SNAPSHOT_VERSION 1
+
+#define SNAPSHOT_MAX_FILES 64
+#define SNAPSHOT_MAX_SIZE (32 * 1024 * 1024)
+
+#define SNAPSHOT_ENTRY_TYPE "(aysuutts)"
+#define SNAPSHOT_TYPE "(utta" SNAPSHOT_ENTRY_TYPE ")"
+
+enum {
+	SNAPSHOT_FLAG_HIDDEN = 1 << 0,
+	SNAPSHOT_FLAG_SYMLINK = 1 << 1
+};
+
+typedef struct {
+	GFile *location;
+	NautilusDirectorySnapshotKey key;
+	GList *infos;
+} LoadJob;
+
+typedef struct {
+	GFile *location;
+	NautilusDirectorySnapshotKey key;
+	GVariant *entries;
+} SaveJob;
+
+typedef struct {
+	char *path;
+	time_t mtime;
+	goffset size;
+} CachedSnapshot;
+
+static gboolean use_snapshots;
+
+static void
+use_snapshots_changed_callback (gpointer callback_data)
+{
+	use_snapshots = g_settings_get_boolean (nautilus_preferences,
+						NAUTILUS_PREFERENCES_DIRECTORY_SNAPSHOTS);
+}
+
+gboolean
+nautilus_directory_snapshot_is_enabled (NautilusDirectory *directory)
+{
+	static gboolean use_snapshots_changed_callback_installed = FALSE;
+
+	if (!use_snapshots_changed_callback_installed) {
+		g_signal_connect_swapped (nautilus_preferences,
+					  "changed::" NAUTILUS_PREFERENCES_DIRECTORY_SNAPSHOTS,
+					  G_CALLBACK (use_snapshots_changed_callback),
+					  NULL);
+		use_snapshots_changed_callback_installed = TRUE;
+
+		use_snapshots_changed_callback (NULL);
+	}
+
+	return use_snapshots && nautilus_directory_is_local (directory);
+}
+
+void
+nautilus_directory_snapshot_key_from_info (GFileInfo *info,
+					   NautilusDirectorySnapshotKey *key)
+{
+	key->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+		g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	key->inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+}
+
+static char *
+get_snapshot_dir (void)
+{
+	return g_build_filename (g_get_user_cache_dir (),
+				 "nautilus", "snapshots", NULL);
+}
+
+static char *
+get_snapshot_path (GFile *location)
+{
+	char *uri, *checksum, *dir, *path;
+
+	uri = g_file_get_uri (location);
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, uri, -1);
+	dir = get_snapshot_dir ();
+	path = g_build_filename (dir, checksum, NULL);
+	g_free (dir);
+	g_free (checksum);
+	g_free (uri);
+
+	return path;
+}
+
+static void
+load_job_free (LoadJob *job)
+{
+	g_object_unref (job->location);
+	g_list_free_full (job->infos, g_object_unref);
+	g_free (job);
+}
+
+static GFileInfo *
+file_info_from_entry (GVariant *entry)
+{
+	GFileInfo *info;
+	const char *name, *display_name, *content_type;
+	guint32 type, flags;
+	guint64 size, mtime;
+
+	g_variant_get (entry, "(^&ay&suutt&s)",
+		       &name, &display_name, &type, &flags,
+		       &size, &mtime, &content_type);
+
+	if (*name == '\0' || strchr (name, '/') != NULL) {
+		return NULL;
+	}
+
+	info = g_file_info_new ();
+	g_file_info_set_name (info, name);
+	g_file_info_set_display_name (info, display_name);
+	g_file_info_set_edit_name (info, display_name);
+	g_file_info_set_file_type (info, type);
+	g_file_info_set_is_hidden (info, (flags & SNAPSHOT_FLAG_HIDDEN) != 0);
+	g_file_info_set_is_symlink (info, (flags & SNAPSHOT_FLAG_SYMLINK) != 0);
+	g_file_info_set_size (info, size);
+	g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED, mtime);
+	if (*content_type != '\0') {
+		g_file_info_set_content_type (info, content_type);
+	}
+
+	return info;
+}
+
+static void
+snapshot_load_thread (GSimpleAsyncResult *res,
+		      GObject *object,
+		      GCancellable *cancellable)
+{
+	LoadJob *job;
+	GVariant *snapshot, *entries, *entry;
+	GVariantIter iter;
+	GFileInfo *info;
+	char *path, *contents;
+	gsize length;
+	guint32 version;
+	guint64 snapshot_mtime, snapshot_inode;
+
+	job = g_simple_async_result_get_op_res_gpointer (res);
+
+	path = get_snapshot_path (job->location);
+	if (!g_file_get_contents (path, &contents, &length, NULL)) {
+		g_free (path);
+		return;
+	}
+
+	snapshot = g_variant_new_from_data (G_VARIANT_TYPE (SNAPSHOT_TYPE),
+					    contents, length, FALSE,
+					    g_free, contents);
+	g_variant_ref_sink (snapshot);
+	g_variant_get (snapshot, "(utt@a" SNAPSHOT_ENTRY_TYPE ")",
+		       &version, &snapshot_mtime, &snapshot_inode, &entries);
+
+	if (version == SNAPSHOT_VERSION &&
+	    snapshot_mtime == job->key.mtime &&
+	    snapshot_inode == job->key.inode) {
+		/* Used now, so it is the last to be pruned. */
+		g_utime (path, NULL);
+
+		g_variant_iter_init (&iter, entries);
+		while (!g_cancellable_is_cancelled (cancellable) &&
+		       (entry = g_variant_iter_next_value (&iter)) != NULL) {
+			info = file_info_from_entry (entry);
+			if (info != NULL) {
+				job->infos = g_list_prepend (job->infos, info);
+			}
+			g_variant_unref (entry);
+		}
+	}
+
+	job->infos = g_list_reverse (job->infos);
+
+	g_variant_unref (entries);
+	g_variant_unref (snapshot);
+	g_free (path);
+}
+
+void
+nautilus_directory_snapshot_load_async (GFile *location,
+					const NautilusDirectorySnapshotKey *key,
+					GCancellable *cancellable,
+					GAsyncReadyCallback callback,
+					gpointer user_data)
+{
+	GSimpleAsyncResult *res;
+	LoadJob *job;
+
+	job = g_new0 (LoadJob, 1);
+	job->location = g_object_ref (location);
+	job->key = *key;
+
+	res = g_simple_async_result_new (G_OBJECT (location), callback, user_data,
+					 nautilus_directory_snapshot_load_async);
+	g_simple_async_result_set_op_res_gpointer (res, job, (GDestroyNotify) load_job_free);
+	g_simple_async_result_run_in_thread (res, snapshot_load_thread,
+					     G_PRIORITY_DEFAULT, cancellable);
+
+	g_object_unref (res);
+}
+
+GList *
+nautilus_directory_snapshot_load_finish (GFile *location,
+					 GAsyncResult *res)
+{
+	LoadJob *job;
+	GList *infos;
+
+	job = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (res));
+	infos = job->infos;
+	job->infos = NULL;
+
+	return infos;
+}
+
+static gint
+cached_snapshot_compare_by_mtime (gconstpointer a,
+				  gconstpointer b)
+{
+	const CachedSnapshot *snapshot_a, *snapshot_b;
+
+	snapshot_a = a;
+	snapshot_b = b;
+
+	/* The most recently used first. */
+	if (snapshot_a->mtime != snapshot_b->mtime) {
+		return snapshot_a->mtime > snapshot_b->mtime ? -1 : 1;
+	}
+	return 0;
+}
+
+static void
+cached_snapshot_free (CachedSnapshot *snapshot)
+{
+	g_free (snapshot->path);
+	g_free (snapshot);
+}
+
+/* Removes the snapshots used least recently until the cache is within
+ * SNAPSHOT_MAX_FILES and SNAPSHOT_MAX_SIZE again.
+ */
+static void
+prune_snapshots (void)
+{
+	GDir *dir;
+	GList *snapshots, *l;
+	CachedSnapshot *snapshot;
+	GStatBuf statbuf;
+	const char *name;
+	char *dirname, *path;
+	goffset total_size;
+	int n_files;
+
+	dirname = get_snapshot_dir ();
+	dir = g_dir_open (dirname, 0, NULL);
+	if (dir == NULL) {
+		g_free (dirname);
+		return;
+	}
+
+	snapshots = NULL;
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		path = g_build_filename (dirname, name, NULL);
+		if (g_stat (path, &statbuf) != 0 || !S_ISREG (statbuf.st_mode)) {
+			g_free (path);
+			continue;
+		}
+
+		snapshot = g_new0 (CachedSnapshot, 1);
+		snapshot->path = path;
+		snapshot->mtime = statbuf.st_mtime;
+		snapshot->size = statbuf.st_size;
+		snapshots = g_list_prepend (snapshots, snapshot);
+	}
+	g_dir_close (dir);
+	g_free (dirname);
+
+	snapshots = g_list_sort (snapshots, cached_snapshot_compare_by_mtime);
+
+	n_files = 0;
+	total_size = 0;
+	for (l = snapshots; l != NULL; l = l->next) {
+		snapshot = l->data;
+
+		n_files++;
+		total_size += snapshot->size;
+		if (n_files > SNAPSHOT_MAX_FILES ||
+		    total_size > SNAPSHOT_MAX_SIZE) {
+			g_unlink (snapshot->path);
+		}
+	}
+
+	g_list_free_full (snapshots, (GDestroyNotify) cached_snapshot_free);
+}
+
+static gboolean
+snapshot_save_job (GIOSchedulerJob *io_job,
+		   GCancellable *cancellable,
+		   gpointer user_data)
+{
+	SaveJob *job;
+	GVariant *snapshot;
+	char *path, *dirname;
+
+	job = user_data;
+
+	snapshot = g_variant_new ("(utt@a" SNAPSHOT_ENTRY_TYPE ")",
+				  SNAPSHOT_VERSION, job->key.mtime, job->key.inode,
+				  job->entries);
+	g_variant_ref_sink (snapshot);
+
+	path = get_snapshot_path (job->location);
+	dirname = g_path_get_dirname (path);
+	if (g_mkdir_with_parents (dirname, 0700) == 0) {
+		g_file_set_contents (path,
+				     g_variant_get_data (snapshot),
+				     g_variant_get_size (snapshot),
+				     NULL);
+	}
+	g_free (dirname);
+	g_free (path);
+
+	g_variant_unref (snapshot);
+
+	prune_snapshots ();
+
+	return FALSE;
+}
+
+static void
+save_job_free (gpointer data)
+{
+	SaveJob *job;
+
+	job = data;
+	g_object_unref (job->location);
+	g_variant_unref (job->entries);
+	g_free (job);
+}
+
+void
+nautilus_directory_snapshot_save (NautilusDirectory *directory,
+				  const NautilusDirectorySnapshotKey *key)
+{
+	GVariantBuilder builder;
+	GList *node;
+	NautilusFile *file;
+	SaveJob *job;
+	guint32 flags;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a" SNAPSHOT_ENTRY_TYPE));
+
+	for (node = directory->details->file_list; node != NULL; node = node->next) {
+		file = NAUTILUS_FILE (node->data);
+
+		if (file->details->is_gone ||
+		    file->details->unconfirmed ||
+		    !file->details->got_file_info) {
+			continue;
+		}
+
+		flags = 0;
+		if (file->details->is_hidden) {
+			flags |= SNAPSHOT_FLAG_HIDDEN;
+		}
+		if (file->details->is_symlink) {
+			flags |= SNAPSHOT_FLAG_SYMLINK;
+		}
+
+		g_variant_builder_add (&builder, "(^aysuutts)",
+				       eel_ref_str_peek (file->details->name),
+				       file->details->display_name != NULL ?
+				       eel_ref_str_peek (file->details->display_name) :
+				       eel_ref_str_peek (file->details->name),
+				       (guint32) file->details->type,
+				       flags,
+				       (guint64) MAX (file->details->size, 0),
+				       (guint64) file->details->mtime,
+				       file->details->mime_type != NULL ?
+				       eel_ref_str_peek (file->details->mime_type) : "");
+	}
+
+	job = g_new0 (SaveJob, 1);
+	job->location = nautilus_directory_get_location (directory);
+	job->key = *key;
+	job->entries = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+	g_io_scheduler_push_job (snapshot_save_job,
+				 job,
+				 save_job_free,
+				 G_PRIORITY_LOW,
+				 NULL);
+}
@@ -0,0 +1,66 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-directory-snapshot.h: On-disk snapshots of directory file lists.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef NAUTILUS_DIRECTORY_SNAPSHOT_H
+#define NAUTILUS_DIRECTORY_SNAPSHOT_H
+
+#include <gio/gio.h>
+#include <libnautilus-private/nautilus-directory.h>
+
+/* Directories with fewer files than this load fast enough without. */
+#define NAUTILUS_DIRECTORY_SNAPSHOT_MIN_FILES 2000
+
+/* The attributes of the directory a snapshot is keyed by. */
+#define NAUTILUS_DIRECTORY_SNAPSHOT_KEY_ATTRIBUTES \
+	G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+	G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC "," \
+	G_FILE_ATTRIBUTE_UNIX_INODE
+
+typedef struct {
+	guint64 mtime;
+	guint64 inode;
+} NautilusDirectorySnapshotKey;
+
+gboolean nautilus_directory_snapshot_is_enabled  (NautilusDirectory            *directory);
+
+void     nautilus_directory_snapshot_key_from_info (GFileInfo                  *info,
+						    NautilusDirectorySnapshotKey *key);
+
+/* Reads the snapshot of @location in a thread. The result is a list
+ * of GFileInfos with name, type, size, modification time and content
+ * type, or NULL if there is no snapshot or it was not taken with @key.
+ */
+void     nautilus_directory_snapshot_load_async  (GFile                        *location,
+						  const NautilusDirectorySnapshotKey *key,
+						  GCancellable                 *cancellable,
+						  GAsyncReadyCallback           callback,
+						  gpointer                      user_data);
+GList *  nautilus_directory_snapshot_load_finish (GFile                        *location,
+						  GAsyncResult                 *res);
+
+/* Takes a snapshot of the current file list of @directory and writes
+ * it out in a thread under @key, which must have been read before the
+ * load that made the file list started.
+ */
+void     nautilus_directory_snapshot_save        (NautilusDirectory            *directory,
+						  const NautilusDirectorySnapshotKey *key);
+
+#endif /* NAUTILUS_DIRECTORY_SNAPSHOT_H */
@@ -40,6 +40,7 @@
 #include <eel/eel-string.h>
 #include <glib/gi18n.h>
 #include <gtk/gtk.h>
+#include <string.h>
 
 enum {
 	FILES_ADDED,
@@ -53,12 +54,44 @@ static guint signals[LAST_SIGNAL];
 
 static GHashTable *directories;
 
+/* Index of directories by URI component. Each node holds one
+ * component of a canonical directory URI, the first level being the
+ * "scheme://authority" part, so lookups by URI string don't need to
+ * build a GFile. Nodes are pruned as soon as they have neither a
+ * directory nor children.
+ */
+struct DirectoryNode {
+	DirectoryNode *parent;
+	eel_ref_str name;
+	GHashTable *children;
+	NautilusDirectory *directory;
+};
+
+static DirectoryNode directory_index_root;
+
+/* Directories whose file list was recently given up by a client,
+ * most recent first. We keep monitoring them so that going back to
+ * them doesn't have to reload everything, within the number of
+ * directories and files the preferences allow.
+ */
+typedef struct {
+	NautilusDirectory *directory;
+	time_t mtime;
+} WarmDirectory;
+
+static GQueue warm_directories = G_QUEUE_INIT;
+static guint warm_directories_max;
+static guint warm_directories_max_files;
+
 static void               nautilus_directory_finalize         (GObject                *object);
 static NautilusDirectory *nautilus_directory_new              (GFile                  *location);
 static GList *            real_get_file_list                  (NautilusDirectory      *directory);
 static gboolean		  real_is_editable                    (NautilusDirectory      *directory);
 static void               set_directory_location              (NautilusDirectory      *directory,
 							       GFile                  *location);
+static void               directory_index_add                 (NautilusDirectory      *directory);
+static void               directory_index_remove              (NautilusDirectory      *directory);
+static void               warm_directories_trim               (void);
 
 G_DEFINE_TYPE (NautilusDirectory, nautilus_directory, G_TYPE_OBJECT);
 
@@ -153,6 +186,7 @@ nautilus_directory_finalize (GObject *object)
 	directory = NAUTILUS_DIRECTORY (object);
 
 	g_hash_table_remove (directories, directory->details->location);
+	directory_index_remove (directory);
 
 	nautilus_directory_cancel (directory);
 	g_assert (directory->details->count_in_progress == NULL);
@@ -297,11 +331,34 @@ async_data_preference_changed_callback (gpointer callback_data)
 	g_hash_table_foreach (directories, async_state_changed_one, NULL);
 }
 
+static void
+warm_directories_limits_changed_callback (gpointer callback_data)
+{
+	warm_directories_max =
+		MAX (0, g_settings_get_int (nautilus_preferences,
+					    NAUTILUS_PREFERENCES_DIRECTORY_CACHE_SIZE));
+	warm_directories_max_files =
+		MAX (0, g_settings_get_int (nautilus_preferences,
+					    NAUTILUS_PREFERENCES_DIRECTORY_CACHE_MAX_FILES));
+
+	warm_directories_trim ();
+}
+
 static void
 add_preferences_callbacks (void)
 {
 	nautilus_global_preferences_init ();
 
+	warm_directories_limits_changed_callback (NULL);
+	g_signal_connect_swapped (nautilus_preferences,
+				  "changed::" NAUTILUS_PREFERENCES_DIRECTORY_CACHE_SIZE,
+				  G_CALLBACK (warm_directories_limits_changed_callback),
+				  NULL);
+	g_signal_connect_swapped (nautilus_preferences,
+				  "changed::" NAUTILUS_PREFERENCES_DIRECTORY_CACHE_MAX_FILES,
+				  G_CALLBACK (warm_directories_limits_changed_callback),
+				  NULL);
+
 	g_signal_connect_swapped (nautilus_preferences,
 				  "changed::" NAUTILUS_PREFERENCES_SHOW_HIDDEN_FILES,
 				  G_CALLBACK(filtering_changed_callback),
@@ -316,6 +373,222 @@ add_preferences_callbacks (void)
 				  NULL);
 }
 
+/* The index only handles URIs in the form g_file_get_uri() returns
+ * for ordinary locations, "scheme://authority/a/b/c" without empty,
+ * "." or ".." components and without query or fragment. Returns the
+ * start of the path, or NULL if @uri has to go through GFile.
+ */
+static const char *
+uri_get_indexable_path (const char *uri)
+{
+	const char *path, *component;
+	size_t length;
+
+	path = strstr (uri, "://");
+	if (path == NULL) {
+		return NULL;
+	}
+	path = strchr (path + 3, '/');
+	if (path == NULL || strpbrk (uri, "?#") != NULL) {
+		return NULL;
+	}
+	if (path[1] == '\0') {
+		return path;
+	}
+
+	for (component = path + 1; component != NULL; ) {
+		length = strcspn (component, "/");
+		if (length == 0 ||
+		    (length == 1 && component[0] == '.') ||
+		    (length == 2 && component[0] == '.' && component[1] == '.')) {
+			return NULL;
+		}
+		component = component[length] == '/' ? component + length + 1 : NULL;
+	}
+
+	return path;
+}
+
+static DirectoryNode *
+directory_node_get_child (DirectoryNode *node,
+			  const char *name,
+			  gboolean create)
+{
+	DirectoryNode *child;
+
+	child = NULL;
+	if (node->children != NULL) {
+		child = g_hash_table_lookup (node->children, name);
+	}
+
+	if (child == NULL && create) {
+		if (node->children == NULL) {
+			node->children = g_hash_table_new (g_str_hash, g_str_equal);
+		}
+		child = g_slice_new0 (DirectoryNode);
+		child->parent = node;
+		child->name = eel_ref_str_get_unique (name);
+		g_hash_table_insert (node->children,
+				     (char *) eel_ref_str_peek (child->name),
+				     child);
+	}
+
+	return child;
+}
+
+static void
+directory_node_prune (DirectoryNode *node)
+{
+	DirectoryNode *parent;
+
+	while (node != &directory_index_root &&
+	       node->directory == NULL &&
+	       (node->children == NULL || g_hash_table_size (node->children) == 0)) {
+		parent = node->parent;
+		g_hash_table_remove (parent->children, eel_ref_str_peek (node->name));
+
+		if (node->children != NULL) {
+			g_hash_table_destroy (node->children);
+		}
+		eel_ref_str_unref (node->name);
+		g_slice_free (DirectoryNode, node);
+
+		node = parent;
+	}
+}
+
+/* Walks the index along the first @length bytes of @uri, which must
+ * have passed uri_get_indexable_path(). A trailing '/' is ignored.
+ */
+static DirectoryNode *
+directory_index_lookup (const char *uri,
+			gsize length,
+			gboolean create)
+{
+	DirectoryNode *node;
+	char *copy, *component, *next;
+
+	copy = g_strndup (uri, length);
+	component = strchr (strstr (copy, "://") + 3, '/');
+	*component++ = '\0';
+
+	node = directory_node_get_child (&directory_index_root, copy, create);
+	while (node != NULL && *component != '\0') {
+		next = strchr (component, '/');
+		if (next != NULL) {
+			*next++ = '\0';
+		} else {
+			next = component + strlen (component);
+		}
+		node = directory_node_get_child (node, component, create);
+		component = next;
+	}
+
+	g_free (copy);
+
+	return node;
+}
+
+static void
+directory_index_add (NautilusDirectory *directory)
+{
+	DirectoryNode *node;
+	char *uri;
+
+	g_assert (directory->details->index_node == NULL);
+
+	uri = g_file_get_uri (directory->details->location);
+	if (uri_get_indexable_path (uri) != NULL) {
+		node = directory_index_lookup (uri, strlen (uri), TRUE);
+		if (node->directory == NULL) {
+			node->directory = directory;
+			directory->details->index_node = node;
+		}
+	}
+	g_free (uri);
+}
+
+static void
+directory_index_remove (NautilusDirectory *directory)
+{
+	DirectoryNode *node;
+
+	node = directory->details->index_node;
+	if (node == NULL) {
+		return;
+	}
+
+	g_assert (node->directory == directory);
+	node->directory = NULL;
+	directory->details->index_node = NULL;
+
+	directory_node_prune (node);
+}
+
+static NautilusDirectory *
+directory_index_get_existing (const char *uri)
+{
+	DirectoryNode *node;
+
+	if (uri_get_indexable_path (uri) == NULL) {
+		return NULL;
+	}
+
+	node = directory_index_lookup (uri, strlen (uri), FALSE);
+	if (node == NULL) {
+		return NULL;
+	}
+
+	return nautilus_directory_ref (node->directory);
+}
+
+/**
+ * nautilus_directory_get_existing_parent_by_uri:
+ * @uri: URI of a file.
+ * @basename: return location for the name of the file.
+ *
+ * Looks up the directory containing @uri in the URI index, without
+ * creating a GFile. Returns a referenced directory and the unescaped
+ * name of the file in it, or NULL if the directory doesn't exist yet
+ * or @uri has to be resolved through GFile.
+ */
+NautilusDirectory *
+nautilus_directory_get_existing_parent_by_uri (const char *uri,
+					       char **basename)
+{
+	DirectoryNode *node;
+	const char *name;
+	char *unescaped;
+
+	*basename = NULL;
+
+	if (directories == NULL ||
+	    uri_get_indexable_path (uri) == NULL) {
+		return NULL;
+	}
+
+	name = strrchr (uri, '/') + 1;
+	if (*name == '\0') {
+		return NULL;
+	}
+
+	node = directory_index_lookup (uri, name - uri, FALSE);
+	if (node == NULL || node->directory == NULL) {
+		return NULL;
+	}
+
+	/* An escaped '/' can't be a file name, let GFile deal with it. */
+	unescaped = g_uri_unescape_string (name, "/");
+	if (unescaped == NULL || *unescaped == '\0') {
+		g_free (unescaped);
+		return NULL;
+	}
+
+	*basename = unescaped;
+
+	return nautilus_directory_ref (node->directory);
+}
+
 /**
  * nautilus_directory_get_by_uri:
  * @uri: URI of directory to get.
@@ -353,6 +626,7 @@ nautilus_directory_get_internal (GFile *location, gboolean create)
 		g_hash_table_insert (directories,
 				     directory->details->location,
 				     directory);
+		directory_index_add (directory);
 	}
 
 	return directory;
@@ -389,6 +663,13 @@ nautilus_directory_get_by_uri (const char *uri)
     		return NULL;
 	}
 
+	if (directories != NULL) {
+		directory = directory_index_get_existing (uri);
+		if (directory != NULL) {
+			return directory;
+		}
+	}
+
 	location = g_file_new_for_uri (uri);
 
 	directory = nautilus_directory_get_internal (location, TRUE);
@@ -1177,12 +1458,14 @@ change_directory_location (NautilusDirectory *directory,
 
 	g_hash_table_remove (directories,
 			     directory->details->location);
+	directory_index_remove (directory);
 
 	set_directory_location (directory, new_location);
 
 	g_hash_table_insert (directories,
 			     directory->details->location,
 			     directory);
+	directory_index_add (directory);
 }
 
 typedef struct {
@@ -1544,6 +1827,174 @@ nautilus_directory_cancel_callback (NautilusDirectory *directory,
 		(directory, callback, callback_data);
 }
 
+static GList *
+warm_directory_find (NautilusDirectory *directory)
+{
+	GList *link;
+	WarmDirectory *warm;
+
+	for (link = warm_directories.head; link != NULL; link = link->next) {
+		warm = link->data;
+		if (warm->directory == directory) {
+			return link;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+warm_directory_free (WarmDirectory *warm)
+{
+	nautilus_directory_file_monitor_remove (warm->directory, &warm_directories);
+	nautilus_directory_unref (warm->directory);
+	g_free (warm);
+}
+
+static void
+warm_directories_trim (void)
+{
+	GList *link;
+	WarmDirectory *warm;
+	guint n_files;
+
+	n_files = 0;
+	for (link = warm_directories.head; link != NULL; link = link->next) {
+		warm = link->data;
+		n_files += g_hash_table_size (warm->directory->details->file_hash);
+	}
+
+	while (!g_queue_is_empty (&warm_directories) &&
+	       (g_queue_get_length (&warm_directories) > warm_directories_max ||
+		n_files > warm_directories_max_files)) {
+		warm = g_queue_pop_tail (&warm_directories);
+		n_files -= g_hash_table_size (warm->directory->details->file_hash);
+		warm_directory_free (warm);
+	}
+}
+
+static time_t
+get_directory_mtime (NautilusDirectory *directory)
+{
+	NautilusFile *file;
+	time_t mtime;
+
+	mtime = 0;
+	file = nautilus_directory_get_existing_corresponding_file (directory);
+	if (file != NULL) {
+		mtime = file->details->mtime;
+		nautilus_file_unref (file);
+	}
+
+	return mtime;
+}
+
+/* Takes over the file list of a directory that one of its clients is
+ * about to stop monitoring, so that it stays loaded if that was the
+ * last client. The monitor is added before the client's is removed,
+ * otherwise the file list would be thrown away in between.
+ */
+static void
+warm_directory_add (NautilusDirectory *directory)
+{
+	GList *link;
+	WarmDirectory *warm;
+
+	if (warm_directories_max == 0 ||
+	    !NAUTILUS_IS_VFS_DIRECTORY (directory) ||
+	    !directory->details->directory_loaded ||
+	    g_hash_table_size (directory->details->file_hash) > warm_directories_max_files) {
+		return;
+	}
+
+	link = warm_directory_find (directory);
+	if (link != NULL) {
+		g_queue_unlink (&warm_directories, link);
+		g_queue_push_head_link (&warm_directories, link);
+		warm = link->data;
+	} else {
+		nautilus_directory_file_monitor_add (directory, &warm_directories,
+						     TRUE, 0, NULL, NULL);
+		warm = g_new0 (WarmDirectory, 1);
+		warm->directory = nautilus_directory_ref (directory);
+		g_queue_push_head (&warm_directories, warm);
+	}
+	warm->mtime = get_directory_mtime (directory);
+
+	warm_directories_trim ();
+}
+
+static void
+warm_directory_query_mtime_callback (GObject *source_object,
+				     GAsyncResult *res,
+				     gpointer user_data)
+{
+	NautilusDirectory *directory;
+	GFileInfo *info;
+	GList *link;
+	WarmDirectory *warm;
+	time_t mtime;
+
+	directory = user_data;
+
+	info = g_file_query_info_finish (G_FILE (source_object), res, NULL);
+	mtime = 0;
+	if (info != NULL) {
+		mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+		g_object_unref (info);
+	}
+
+	link = warm_directory_find (directory);
+	if (link != NULL) {
+		warm = link->data;
+		if (mtime == 0 || mtime != warm->mtime) {
+			nautilus_directory_force_reload (directory);
+		}
+		warm->mtime = mtime;
+	}
+
+	nautilus_directory_unref (directory);
+}
+
+/* Called when a client starts monitoring a directory again. Local
+ * directories were kept up to date by their file monitor while they
+ * were warm, remote ones may not have one that works, so we compare
+ * the directory's modification time instead of trusting the list.
+ */
+static void
+warm_directory_reuse (NautilusDirectory *directory)
+{
+	GList *link;
+
+	link = warm_directory_find (directory);
+	if (link == NULL) {
+		return;
+	}
+
+	g_queue_unlink (&warm_directories, link);
+	g_queue_push_head_link (&warm_directories, link);
+
+	if (!nautilus_directory_is_local (directory)) {
+		g_file_query_info_async (directory->details->location,
+					 G_FILE_ATTRIBUTE_TIME_MODIFIED,
+					 0,
+					 G_PRIORITY_DEFAULT,
+					 NULL,
+					 warm_directory_query_mtime_callback,
+					 nautilus_directory_ref (directory));
+	}
+}
+
+void
+nautilus_directory_drop_warm_directories (void)
+{
+	WarmDirectory *warm;
+
+	while ((warm = g_queue_pop_head (&warm_directories)) != NULL) {
+		warm_directory_free (warm);
+	}
+}
+
 void
 nautilus_directory_file_monitor_add (NautilusDirectory *directory,
 				     gconstpointer client,
@@ -1555,6 +2006,10 @@ nautilus_directory_file_monitor_add (NautilusDirectory *directory,
 	g_return_if_fail (NAUTILUS_IS_DIRECTORY (directory));
 	g_return_if_fail (client != NULL);
 
+	if (client != &warm_directories) {
+		warm_directory_reuse (directory);
+	}
+
 	NAUTILUS_DIRECTORY_CLASS (G_OBJECT_GET_CLASS (directory))->file_monitor_add 
 		(directory, client,
 		 monitor_hidden_files,
@@ -1569,6 +2024,10 @@ nautilus_directory_file_monitor_remove (NautilusDirectory *directory,
 	g_return_if_fail (NAUTILUS_IS_DIRECTORY (directory));
 	g_return_if_fail (client != NULL);
 
+	if (client != &warm_directories) {
+		warm_directory_add (directory);
+	}
+
 	NAUTILUS_DIRECTORY_CLASS (G_OBJECT_GET_CLASS (directory))->file_monitor_remove
 		(directory, client);
 }
@@ -1838,6 +2297,8 @@ nautilus_self_check_directory (void)
 
 	nautilus_directory_unref (directory);
 
+	nautilus_directory_drop_warm_directories ();
+
 	while (g_hash_table_size (directories) != 0) {
 		gtk_main_iteration ();
 	}
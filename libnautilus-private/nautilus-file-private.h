@@ -147,6 +147,10 @@ struct NautilusFileDetails
 	/* Set when emitting files_added on the directory to make sure we
 	   add a file, and only once */
 	eel_boolean_bit is_added                      : 1;
+	/* Set while all that is known about the file is what the
+	 * directory snapshot said, until the file is seen on disk.
+	 */
+	eel_boolean_bit from_snapshot                 : 1;
 	/* Set by the NautilusDirectory while it's loading the file
 	 * list so the file knows not to do redundant I/O.
 	 */
@@ -1255,6 +1255,118 @@ nautilus_get_cached_x_content_types_for_mount (GMount *mount)
 	return NULL;
 }
 
+/* Descriptions of content types, looked up in shared-mime-info once
+ * per type. Types seen while loading directories are looked up ahead
+ * of time in a thread, so that sorting by type or showing the type
+ * column doesn't stall the main loop. A type that is in the table
+ * with a NULL description is queued for the thread.
+ */
+static GHashTable *content_type_descriptions;
+static GThreadPool *content_type_description_pool;
+G_LOCK_DEFINE_STATIC (content_type_descriptions);
+
+static const char *
+lookup_content_type_description (const char *content_type,
+				 gboolean *known)
+{
+	gpointer description;
+
+	if (content_type_descriptions == NULL) {
+		content_type_descriptions = g_hash_table_new_full (g_str_hash, g_str_equal,
+								   g_free, g_free);
+	}
+
+	description = NULL;
+	*known = g_hash_table_lookup_extended (content_type_descriptions,
+					       content_type, NULL, &description);
+
+	return description;
+}
+
+/**
+ * nautilus_get_content_type_description:
+ * @content_type: a content type.
+ *
+ * Like g_content_type_get_description(), but only asks shared-mime-info
+ * the first time a type is seen.
+ *
+ * Returns: the description, owned by the cache and valid until exit.
+ */
+const char *
+nautilus_get_content_type_description (const char *content_type)
+{
+	const char *description;
+	char *new_description;
+	gboolean known;
+
+	G_LOCK (content_type_descriptions);
+	description = lookup_content_type_description (content_type, &known);
+	G_UNLOCK (content_type_descriptions);
+
+	if (description != NULL) {
+		return description;
+	}
+
+	new_description = g_content_type_get_description (content_type);
+
+	G_LOCK (content_type_descriptions);
+	description = lookup_content_type_description (content_type, &known);
+	if (description == NULL) {
+		g_hash_table_replace (content_type_descriptions,
+				      g_strdup (content_type), new_description);
+		description = new_description;
+	} else {
+		g_free (new_description);
+	}
+	G_UNLOCK (content_type_descriptions);
+
+	return description;
+}
+
+static void
+content_type_description_thread (gpointer data,
+				 gpointer user_data)
+{
+	char *content_type;
+
+	content_type = data;
+	nautilus_get_content_type_description (content_type);
+	g_free (content_type);
+}
+
+/**
+ * nautilus_prefetch_content_type_description:
+ * @content_type: a content type.
+ *
+ * Looks up the description of @content_type in a thread, unless it
+ * is already known or queued.
+ */
+void
+nautilus_prefetch_content_type_description (const char *content_type)
+{
+	gboolean known;
+
+	G_LOCK (content_type_descriptions);
+	lookup_content_type_description (content_type, &known);
+	if (!known) {
+		g_hash_table_insert (content_type_descriptions,
+				     g_strdup (content_type), NULL);
+	}
+	G_UNLOCK (content_type_descriptions);
+
+	if (known) {
+		return;
+	}
+
+	if (content_type_description_pool == NULL) {
+		content_type_description_pool =
+			g_thread_pool_new (content_type_description_thread, NULL,
+					   2, FALSE, NULL);
+	}
+	g_thread_pool_push (content_type_description_pool,
+			    g_strdup (content_type), NULL);
+}
+
 #if !defined (NAUTILUS_OMIT_SELF_CHECK)
 
 void
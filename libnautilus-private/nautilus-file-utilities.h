@@ -92,4 +92,7 @@ void nautilus_get_x_content_types_for_mount_async (GMount *mount,
 						   GCancellable *cancellable,
 						   gpointer user_data);
 
+const char * nautilus_get_content_type_description      (const char *content_type);
+void         nautilus_prefetch_content_type_description (const char *content_type);
+
 #endif /* NAUTILUS_FILE_UTILITIES_H */
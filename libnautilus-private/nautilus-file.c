@@ -725,11 +725,49 @@ nautilus_file_get_existing (GFile *location)
 	return nautilus_file_get_internal (location, FALSE);
 }
 
+/* Resolves @uri through the directory URI index when its parent
+ * directory already exists, which avoids creating GFiles for the
+ * common case of files in directories we already know about.
+ */
+static gboolean
+get_by_uri_from_index (const char *uri,
+		       gboolean create,
+		       NautilusFile **file_out)
+{
+	NautilusDirectory *directory;
+	NautilusFile *file;
+	char *basename;
+
+	directory = nautilus_directory_get_existing_parent_by_uri (uri, &basename);
+	if (directory == NULL) {
+		return FALSE;
+	}
+
+	file = nautilus_directory_find_file_by_name (directory, basename);
+	if (file != NULL) {
+		nautilus_file_ref (file);
+	} else if (create) {
+		file = nautilus_file_new_from_filename (directory, basename, FALSE);
+		nautilus_directory_add_file (directory, file);
+	}
+
+	g_free (basename);
+	nautilus_directory_unref (directory);
+
+	*file_out = file;
+
+	return TRUE;
+}
+
 NautilusFile *
 nautilus_file_get_existing_by_uri (const char *uri)
 {
 	GFile *location;
 	NautilusFile *file;
+
+	if (get_by_uri_from_index (uri, FALSE, &file)) {
+		return file;
+	}
 	
 	location = g_file_new_for_uri (uri);
 	file = nautilus_file_get_internal (location, FALSE);
@@ -743,6 +781,10 @@ nautilus_file_get_by_uri (const char *uri)
 {
 	GFile *location;
 	NautilusFile *file;
+
+	if (get_by_uri_from_index (uri, TRUE, &file)) {
+		return file;
+	}
 	
 	location = g_file_new_for_uri (uri);
 	file = nautilus_file_get_internal (location, TRUE);
@@ -2083,6 +2125,34 @@ update_links_if_target (NautilusFile *target_file)
 	nautilus_file_list_free (link_files);
 }
 
+/* Files of the same type almost always get the same icon, so share
+ * one icon object per content type instead of keeping one per file.
+ */
+static GIcon *
+get_shared_icon (const char *mime_type,
+		 GIcon *icon)
+{
+	static GHashTable *shared_icons = NULL;
+	GIcon *shared_icon;
+
+	if (mime_type == NULL || icon == NULL) {
+		return icon;
+	}
+
+	if (shared_icons == NULL) {
+		shared_icons = g_hash_table_new_full (g_str_hash, g_str_equal,
+						      g_free, g_object_unref);
+	}
+
+	shared_icon = g_hash_table_lookup (shared_icons, mime_type);
+	if (shared_icon == NULL) {
+		g_hash_table_insert (shared_icons, g_strdup (mime_type), g_object_ref (icon));
+		return icon;
+	}
+
+	return g_icon_equal (shared_icon, icon) ? shared_icon : icon;
+}
+
 static gboolean
 update_info_internal (NautilusFile *file,
 		      GFileInfo *info,
@@ -2400,7 +2470,8 @@ update_info_internal (NautilusFile *file,
 		changed = TRUE;
 	}
 
-	icon = g_file_info_get_icon (info);
+	icon = get_shared_icon (g_file_info_get_content_type (info),
+				g_file_info_get_icon (info));
 	if (!g_icon_equal (icon, file->details->icon)) {
 		changed = TRUE;
 
@@ -3822,6 +3893,78 @@ nautilus_file_monitor_remove (NautilusFile *file,
 	NAUTILUS_FILE_CLASS (G_OBJECT_GET_CLASS (file))->monitor_remove (file, client);
 }			      
 
+static GHashTable *
+freeze_file_list_directories (GList *file_list)
+{
+	GHashTable *directories;
+	NautilusDirectory *directory;
+	GList *l;
+
+	directories = g_hash_table_new_full (NULL, NULL,
+					     (GDestroyNotify) nautilus_directory_unref, NULL);
+
+	for (l = file_list; l != NULL; l = l->next) {
+		directory = NAUTILUS_FILE (l->data)->details->directory;
+		if (directory != NULL &&
+		    !g_hash_table_lookup_extended (directories, directory, NULL, NULL)) {
+			nautilus_directory_freeze_async_state (directory);
+			g_hash_table_insert (directories, nautilus_directory_ref (directory), NULL);
+		}
+	}
+
+	return directories;
+}
+
+static void
+thaw_file_list_directories (GHashTable *directories)
+{
+	GHashTableIter iter;
+	NautilusDirectory *directory;
+
+	g_hash_table_iter_init (&iter, directories);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &directory, NULL)) {
+		nautilus_directory_thaw_async_state (directory);
+	}
+
+	g_hash_table_destroy (directories);
+}
+
+/**
+ * nautilus_file_list_monitor_add
+ *
+ * Monitor all the files in a list, starting I/O once per directory
+ * rather than once per file.
+ * @file_list: GList of files.
+ **/
+void
+nautilus_file_list_monitor_add (GList *file_list,
+				gconstpointer client,
+				NautilusFileAttributes attributes)
+{
+	GHashTable *directories;
+	GList *l;
+
+	directories = freeze_file_list_directories (file_list);
+	for (l = file_list; l != NULL; l = l->next) {
+		nautilus_file_monitor_add (l->data, client, attributes);
+	}
+	thaw_file_list_directories (directories);
+}
+
+void
+nautilus_file_list_monitor_remove (GList *file_list,
+				   gconstpointer client)
+{
+	GHashTable *directories;
+	GList *l;
+
+	directories = freeze_file_list_directories (file_list);
+	for (l = file_list; l != NULL; l = l->next) {
+		nautilus_file_monitor_remove (l->data, client);
+	}
+	thaw_file_list_directories (directories);
+}
+
 gboolean
 nautilus_file_is_launcher (NautilusFile *file)
 {
@@ -6331,7 +6474,7 @@ static char *
 get_description (NautilusFile *file)
 {
 	const char *mime_type;
-	char *description;
+	const char *description;
 
 	g_assert (NAUTILUS_IS_FILE (file));
 
@@ -6345,9 +6488,9 @@ get_description (NautilusFile *file)
 		return g_strdup (_("program"));
 	}
 
-	description = g_content_type_get_description (mime_type);
+	description = nautilus_get_content_type_description (mime_type);
 	if (g_strcmp0 (description, NULL) != 0) {
-		return description;
+		return g_strdup (description);
 	}
 
 	return g_strdup (mime_type);
@@ -135,6 +135,11 @@ void                    nautilus_file_monitor_add                       (Nautilu
 									 NautilusFileAttributes          attributes);
 void                    nautilus_file_monitor_remove                    (NautilusFile                   *file,
 									 gconstpointer                   client);
+void                    nautilus_file_list_monitor_add                  (GList                          *file_list,
+									 gconstpointer                   client,
+									 NautilusFileAttributes          attributes);
+void                    nautilus_file_list_monitor_remove               (GList                          *file_list,
+									 gconstpointer                   client);
 
 /* Waiting for data that's read asynchronously.
  * This interface currently works only for metadata, but could be expanded
@@ -151,6 +151,20 @@ typedef enum
 #define NAUTILUS_PREFERENCES_SHOW_FILE_THUMBNAILS	"show-image-thumbnails"
 #define NAUTILUS_PREFERENCES_FILE_THUMBNAIL_LIMIT	"thumbnail-limit"
 
+/* Recently visited folders kept loaded */
+#define NAUTILUS_PREFERENCES_DIRECTORY_CACHE_SIZE	"directory-cache-size"
+#define NAUTILUS_PREFERENCES_DIRECTORY_CACHE_MAX_FILES	"directory-cache-max-files"
+#define NAUTILUS_PREFERENCES_DIRECTORY_SNAPSHOTS	"directory-snapshots"
+
+/* Searching */
+#define NAUTILUS_PREFERENCES_SEARCH_FILE_CONTENTS	"search-file-contents"
+#define NAUTILUS_PREFERENCES_SEARCH_STAY_ON_FILESYSTEM	"search-stay-on-filesystem"
+#define NAUTILUS_PREFERENCES_SEARCH_SKIP_REMOTE_MOUNTS	"search-skip-remote-mounts"
+#define NAUTILUS_PREFERENCES_SEARCH_IGNORE_PATTERNS	"search-ignore-patterns"
+#define NAUTILUS_PREFERENCES_SEARCH_MAX_DEPTH		"search-max-depth"
+#define NAUTILUS_PREFERENCES_SEARCH_MOUNT_TIME_BUDGET	"search-mount-time-budget"
+#define NAUTILUS_PREFERENCES_SEARCH_MOUNT_ENTRY_BUDGET	"search-mount-entry-budget"
+
 typedef enum
 {
 	NAUTILUS_COMPLEX_SEARCH_BAR,
@@ -0,0 +1,199 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-icon-effects.c: Cache of icons rendered with highlight effects.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <config.h>
+#include "nautilus-icon-effects.h"
+
+#include <eel/eel-debug.h>
+#include <eel/eel-graphic-effects.h>
+#include <math.h>
+
+/* Enough for a few thousand prelit or selected icons at the usual sizes */
+#define CACHE_MAX_BYTES (16 * 1024 * 1024)
+
+/* Entries are keyed by the identity of their source pixbuf, which is
+ * watched with a weak reference so that the entries go away with it
+ * and its address is never mistaken for a different pixbuf.
+ */
+typedef struct {
+	GdkPixbuf *source;
+	NautilusIconEffects effects;
+	guint32 color;
+} CacheKey;
+
+typedef struct {
+	CacheKey key;
+	GdkPixbuf *rendered;
+	gsize size;
+	GList link;
+} CacheEntry;
+
+static GHashTable *cache;
+/* Most recently used first */
+static GQueue cache_lru = G_QUEUE_INIT;
+static gsize cache_size;
+
+static guint
+cache_key_hash (gconstpointer p)
+{
+	const CacheKey *key = p;
+
+	return g_direct_hash (key->source) ^ (key->effects << 24) ^ key->color;
+}
+
+static gboolean
+cache_key_equal (gconstpointer a,
+		 gconstpointer b)
+{
+	const CacheKey *key_a = a, *key_b = b;
+
+	return key_a->source == key_b->source &&
+		key_a->effects == key_b->effects &&
+		key_a->color == key_b->color;
+}
+
+/* The colorizing effect only uses 8 bits of each channel */
+static guint32
+pack_color (const GdkRGBA *color)
+{
+	return (guint32) CLAMP ((int) floor (color->red * 255), 0, 255) << 16 |
+		(guint32) CLAMP ((int) floor (color->green * 255), 0, 255) << 8 |
+		(guint32) CLAMP ((int) floor (color->blue * 255), 0, 255);
+}
+
+static void source_finalized (gpointer data,
+			      GObject *where_the_object_was);
+
+static void
+cache_entry_remove (CacheEntry *entry,
+		    gboolean source_alive)
+{
+	if (source_alive) {
+		g_object_weak_unref (G_OBJECT (entry->key.source), source_finalized, entry);
+	}
+
+	g_hash_table_remove (cache, &entry->key);
+	g_queue_unlink (&cache_lru, &entry->link);
+	cache_size -= entry->size;
+
+	g_object_unref (entry->rendered);
+	g_slice_free (CacheEntry, entry);
+}
+
+static void
+source_finalized (gpointer data,
+		  GObject *where_the_object_was)
+{
+	cache_entry_remove (data, FALSE);
+}
+
+static void
+cache_trim (void)
+{
+	while (cache_size > CACHE_MAX_BYTES && cache_lru.tail != NULL) {
+		cache_entry_remove (cache_lru.tail->data, TRUE);
+	}
+}
+
+void
+nautilus_icon_effects_clear_cache (void)
+{
+	while (cache_lru.head != NULL) {
+		cache_entry_remove (cache_lru.head->data, TRUE);
+	}
+}
+
+static GdkPixbuf *
+render (GdkPixbuf *pixbuf,
+	NautilusIconEffects effects,
+	const GdkRGBA *color)
+{
+	GdkPixbuf *rendered, *colorized;
+
+	rendered = g_object_ref (pixbuf);
+
+	if (effects & NAUTILUS_ICON_EFFECT_SPOTLIGHT) {
+		g_object_unref (rendered);
+		rendered = eel_create_spotlight_pixbuf (pixbuf);
+	}
+
+	if (effects & NAUTILUS_ICON_EFFECT_COLORIZE) {
+		colorized = eel_create_colorized_pixbuf (rendered, (GdkRGBA *) color);
+		g_object_unref (rendered);
+		rendered = colorized;
+	}
+
+	return rendered;
+}
+
+GdkPixbuf *
+nautilus_icon_effects_apply (GdkPixbuf *pixbuf,
+			     NautilusIconEffects effects,
+			     const GdkRGBA *color)
+{
+	CacheKey key;
+	CacheEntry *entry;
+	GdkPixbuf *rendered;
+
+	g_return_val_if_fail (GDK_IS_PIXBUF (pixbuf), NULL);
+	g_return_val_if_fail (color != NULL || !(effects & NAUTILUS_ICON_EFFECT_COLORIZE), NULL);
+
+	if (effects == 0) {
+		return g_object_ref (pixbuf);
+	}
+
+	if (cache == NULL) {
+		cache = g_hash_table_new (cache_key_hash, cache_key_equal);
+		eel_debug_call_at_shutdown (nautilus_icon_effects_clear_cache);
+	}
+
+	key.source = pixbuf;
+	key.effects = effects;
+	key.color = (effects & NAUTILUS_ICON_EFFECT_COLORIZE) ? pack_color (color) : 0;
+
+	entry = g_hash_table_lookup (cache, &key);
+	if (entry != NULL) {
+		g_queue_unlink (&cache_lru, &entry->link);
+		g_queue_push_head_link (&cache_lru, &entry->link);
+
+		return g_object_ref (entry->rendered);
+	}
+
+	rendered = render (pixbuf, effects, color);
+	if (rendered == NULL) {
+		return NULL;
+	}
+
+	entry = g_slice_new0 (CacheEntry);
+	entry->key = key;
+	entry->rendered = g_object_ref (rendered);
+	entry->size = (gsize) gdk_pixbuf_get_rowstride (rendered) * gdk_pixbuf_get_height (rendered);
+	entry->link.data = entry;
+
+	g_object_weak_ref (G_OBJECT (pixbuf), source_finalized, entry);
+	g_hash_table_insert (cache, &entry->key, entry);
+	g_queue_push_head_link (&cache_lru, &entry->link);
+	cache_size += entry->size;
+
+	cache_trim ();
+
+	return rendered;
+}
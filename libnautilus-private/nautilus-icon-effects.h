@@ -0,0 +1,45 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-icon-effects.h: Cache of icons rendered with highlight effects.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef NAUTILUS_ICON_EFFECTS_H
+#define NAUTILUS_ICON_EFFECTS_H
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gdk/gdk.h>
+
+typedef enum {
+	NAUTILUS_ICON_EFFECT_SPOTLIGHT = 1 << 0,
+	NAUTILUS_ICON_EFFECT_COLORIZE  = 1 << 1
+} NautilusIconEffects;
+
+/* Returns @pixbuf lightened and/or colorized with @color, the same
+ * way eel_create_spotlight_pixbuf() and eel_create_colorized_pixbuf()
+ * do. Results are shared for as long as @pixbuf is alive and they fit
+ * in the cache, so prelighting or selecting many items showing the
+ * same icon renders it once. @color is only used for
+ * NAUTILUS_ICON_EFFECT_COLORIZE.
+ */
+GdkPixbuf *nautilus_icon_effects_apply       (GdkPixbuf           *pixbuf,
+					      NautilusIconEffects  effects,
+					      const GdkRGBA       *color);
+void       nautilus_icon_effects_clear_cache (void);
+
+#endif /* NAUTILUS_ICON_EFFECTS_H */
@@ -29,6 +29,7 @@
 #include "nautilus-directory-private.h"
 #include "nautilus-directory-notify.h"
 #include "nautilus-file.h"
+#include "nautilus-file-private.h"
 #include <eel/eel-glib-extensions.h>
 #include <gtk/gtk.h>
 
@@ -37,6 +38,22 @@ struct NautilusMergedDirectoryDetails {
 	GList *directories_not_done_loading;
 	GHashTable *callbacks;
 	GHashTable *monitors;
+
+	/* The real directories are monitored once for all the monitors
+	 * of the merged directory, with what they want between them.
+	 */
+	gboolean monitoring;
+	gboolean monitor_hidden_files;
+	NautilusFileAttributes monitor_attributes;
+
+	/* Files added and changed in the real directories, forwarded
+	 * together from an idle.
+	 */
+	GList *pending_added;
+	GHashTable *pending_added_hash;
+	GList *pending_changed;
+	GHashTable *pending_changed_hash;
+	guint forward_idle_id;
 };
 
 typedef struct {
@@ -237,19 +254,57 @@ merged_cancel_callback (NautilusDirectory *directory,
 	merged_callback_destroy (merged_callback);
 }
 
+/* Monitors the real directories with what the merged monitors want
+ * between them, or stops monitoring them when there are none left.
+ * Only calls through to the real directories when that changes.
+ */
 static void
-build_merged_callback_list (NautilusDirectory *directory,
-			    GList *file_list,
-			    gpointer callback_data)
+update_real_monitors (NautilusMergedDirectory *merged)
 {
-	GList **merged_list;
+	GHashTableIter iter;
+	MergedMonitor *monitor;
+	gboolean monitor_hidden_files;
+	NautilusFileAttributes monitor_attributes;
+	GList *node;
+
+	if (g_hash_table_size (merged->details->monitors) == 0) {
+		if (merged->details->monitoring) {
+			for (node = merged->details->directories; node != NULL; node = node->next) {
+				nautilus_directory_file_monitor_remove (node->data, merged);
+			}
+			merged->details->monitoring = FALSE;
+		}
+		return;
+	}
 
-	merged_list = callback_data;
-	*merged_list = g_list_concat (*merged_list,
-				      nautilus_file_list_copy (file_list));
+	monitor_hidden_files = FALSE;
+	monitor_attributes = 0;
+	g_hash_table_iter_init (&iter, merged->details->monitors);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &monitor)) {
+		monitor_hidden_files |= monitor->monitor_hidden_files;
+		monitor_attributes |= monitor->monitor_attributes;
+	}
+
+	if (merged->details->monitoring &&
+	    merged->details->monitor_hidden_files == monitor_hidden_files &&
+	    merged->details->monitor_attributes == monitor_attributes) {
+		return;
+	}
+
+	merged->details->monitoring = TRUE;
+	merged->details->monitor_hidden_files = monitor_hidden_files;
+	merged->details->monitor_attributes = monitor_attributes;
+
+	/* Adding again replaces the monitor of the same client */
+	for (node = merged->details->directories; node != NULL; node = node->next) {
+		nautilus_directory_file_monitor_add
+			(node->data, merged,
+			 monitor_hidden_files,
+			 monitor_attributes,
+			 NULL, NULL);
+	}
 }
 
-/* Create a monitor on each of the directories in the list. */
 static void
 merged_monitor_add (NautilusDirectory *directory,
 		    gconstpointer client,
@@ -265,9 +320,6 @@ merged_monitor_add (NautilusDirectory *directory,
 
 	merged = NAUTILUS_MERGED_DIRECTORY (directory);
 
-	/* Map the client to a unique value so this doesn't interfere
-	 * with direct monitoring of the directory by the same client.
-	 */
 	monitor = g_hash_table_lookup (merged->details->monitors, client);
 	if (monitor != NULL) {
 		g_assert (monitor->merged == merged);
@@ -280,35 +332,20 @@ merged_monitor_add (NautilusDirectory *directory,
 	monitor->monitor_hidden_files = monitor_hidden_files;
 	monitor->monitor_attributes = file_attributes;
 
-	/* Call through to the real directory add calls. */
-	merged_callback_list = NULL;
-	for (node = merged->details->directories; node != NULL; node = node->next) {
-		nautilus_directory_file_monitor_add
-			(node->data, monitor,
-			 monitor_hidden_files,
-			 file_attributes,
-			 build_merged_callback_list, &merged_callback_list);
-	}
+	update_real_monitors (merged);
+
 	if (callback != NULL) {
+		merged_callback_list = NULL;
+		for (node = merged->details->directories; node != NULL; node = node->next) {
+			merged_callback_list = g_list_concat
+				(merged_callback_list,
+				 nautilus_directory_get_file_list (node->data));
+		}
 		(* callback) (directory, merged_callback_list, callback_data);
+		nautilus_file_list_free (merged_callback_list);
 	}
-	nautilus_file_list_free (merged_callback_list);
-}
-
-static void
-merged_monitor_destroy (NautilusMergedDirectory *merged, MergedMonitor *monitor)
-{
-	GList *node;
-
-	/* Call through to the real directory remove calls. */
-	for (node = merged->details->directories; node != NULL; node = node->next) {
-		nautilus_directory_file_monitor_remove (node->data, monitor);
-	}
-
-	g_free (monitor);
 }
 
-/* Remove the monitor from each of the directories in the list. */
 static void
 merged_monitor_remove (NautilusDirectory *directory,
 		       gconstpointer client)
@@ -318,14 +355,13 @@ merged_monitor_remove (NautilusDirectory *directory,
 	
 	merged = NAUTILUS_MERGED_DIRECTORY (directory);
 	
-	/* Map the client to the value used by the earlier add call. */
         monitor = g_hash_table_lookup (merged->details->monitors, client);
 	if (monitor == NULL) {
 		return;
 	}
 	g_hash_table_remove (merged->details->monitors, client);
 
-	merged_monitor_destroy (merged, monitor);
+	update_real_monitors (merged);
 }
 
 static void
@@ -418,12 +454,84 @@ merged_get_file_list (NautilusDirectory *directory)
 	return g_list_concat (dirs_file_list, merged_dir_file_list);
 }
 
+static void
+forward_pending_files (NautilusMergedDirectory *merged)
+{
+	GList *added, *changed;
+
+	if (merged->details->forward_idle_id != 0) {
+		g_source_remove (merged->details->forward_idle_id);
+		merged->details->forward_idle_id = 0;
+	}
+
+	added = g_list_reverse (merged->details->pending_added);
+	changed = g_list_reverse (merged->details->pending_changed);
+	merged->details->pending_added = NULL;
+	merged->details->pending_changed = NULL;
+	g_hash_table_remove_all (merged->details->pending_added_hash);
+	g_hash_table_remove_all (merged->details->pending_changed_hash);
+
+	/* Added files go first, the changes may be about them */
+	if (added != NULL) {
+		nautilus_directory_emit_files_added (NAUTILUS_DIRECTORY (merged), added);
+	}
+	if (changed != NULL) {
+		nautilus_directory_emit_files_changed (NAUTILUS_DIRECTORY (merged), changed);
+	}
+
+	nautilus_file_list_free (added);
+	nautilus_file_list_free (changed);
+}
+
+static gboolean
+forward_idle_callback (gpointer callback_data)
+{
+	NautilusMergedDirectory *merged;
+
+	merged = NAUTILUS_MERGED_DIRECTORY (callback_data);
+	merged->details->forward_idle_id = 0;
+
+	nautilus_directory_ref (NAUTILUS_DIRECTORY (merged));
+	forward_pending_files (merged);
+	nautilus_directory_unref (NAUTILUS_DIRECTORY (merged));
+
+	return FALSE;
+}
+
+static void
+queue_pending_files (NautilusMergedDirectory *merged,
+		     GList **pending,
+		     GHashTable *pending_hash,
+		     GList *files)
+{
+	GList *node;
+
+	for (node = files; node != NULL; node = node->next) {
+		if (g_hash_table_lookup (pending_hash, node->data) != NULL) {
+			continue;
+		}
+		g_hash_table_insert (pending_hash, node->data, node->data);
+		*pending = g_list_prepend (*pending, nautilus_file_ref (node->data));
+	}
+
+	if (merged->details->forward_idle_id == 0) {
+		merged->details->forward_idle_id =
+			g_idle_add (forward_idle_callback, merged);
+	}
+}
+
 static void
 forward_files_added_cover (NautilusDirectory *real_directory,
 			   GList *files,
 			   gpointer callback_data)
 {
-	nautilus_directory_emit_files_added (NAUTILUS_DIRECTORY (callback_data), files);
+	NautilusMergedDirectory *merged;
+
+	merged = NAUTILUS_MERGED_DIRECTORY (callback_data);
+	queue_pending_files (merged,
+			     &merged->details->pending_added,
+			     merged->details->pending_added_hash,
+			     files);
 }
 
 static void
@@ -431,7 +539,13 @@ forward_files_changed_cover (NautilusDirectory *real_directory,
 			     GList *files,
 			     gpointer callback_data)
 {
-	nautilus_directory_emit_files_changed (NAUTILUS_DIRECTORY (callback_data), files);
+	NautilusMergedDirectory *merged;
+
+	merged = NAUTILUS_MERGED_DIRECTORY (callback_data);
+	queue_pending_files (merged,
+			     &merged->details->pending_changed,
+			     merged->details->pending_changed_hash,
+			     files);
 }
 
 static void
@@ -441,25 +555,12 @@ done_loading_callback (NautilusDirectory *real_directory,
 	merged->details->directories_not_done_loading = g_list_remove
 		(merged->details->directories_not_done_loading, real_directory);
 	if (merged->details->directories_not_done_loading == NULL) {
+		/* Everything that was loaded is in before done_loading */
+		forward_pending_files (merged);
 		nautilus_directory_emit_done_loading (NAUTILUS_DIRECTORY (merged));
 	}
 }
 
-static void
-monitor_add_directory (gpointer key,
-		       gpointer value,
-		       gpointer callback_data)
-{
-	MergedMonitor *monitor;
-	
-	monitor = value;
-	nautilus_directory_file_monitor_add
-		(NAUTILUS_DIRECTORY (callback_data), monitor,
-		 monitor->monitor_hidden_files,
-		 monitor->monitor_attributes,
-		 forward_files_added_cover, monitor->merged);
-}
-
 static void
 merged_add_real_directory (NautilusMergedDirectory *merged,
 			   NautilusDirectory *real_directory)
@@ -483,10 +584,14 @@ merged_add_real_directory (NautilusMergedDirectory *merged,
          * we have no directories in our list.
 	 */
 
-	/* Add the directory to any extant monitors. */
-	g_hash_table_foreach (merged->details->monitors,
-			      monitor_add_directory,
-			      real_directory);
+	/* Add the directory to the extant monitor. */
+	if (merged->details->monitoring) {
+		nautilus_directory_file_monitor_add
+			(real_directory, merged,
+			 merged->details->monitor_hidden_files,
+			 merged->details->monitor_attributes,
+			 forward_files_added_cover, merged);
+	}
 	/* FIXME bugzilla.gnome.org 42541: Do we need to add the directory to callbacks too? */
 
 	g_signal_connect_object (real_directory, "files_added",
@@ -526,15 +631,6 @@ merged_callback_remove_directory_cover (gpointer key,
 		(value, NAUTILUS_DIRECTORY (callback_data));
 }
 
-static void
-monitor_remove_directory (gpointer key,
-			  gpointer value,
-			  gpointer callback_data)
-{
-	nautilus_directory_file_monitor_remove
-		(NAUTILUS_DIRECTORY (callback_data), value);
-}
-
 static void
 real_directory_notify_files_removed (NautilusDirectory *real_directory)
 {
@@ -560,14 +656,44 @@ real_directory_notify_files_removed (NautilusDirectory *real_directory)
 	g_list_free_full (files, g_free);
 }
 
+/* The files of a directory that is taken out are not forwarded */
+static void
+drop_pending_files (GList **pending,
+		    GHashTable *pending_hash,
+		    NautilusDirectory *real_directory)
+{
+	GList *node, *next;
+	NautilusFile *file;
+
+	for (node = *pending; node != NULL; node = next) {
+		next = node->next;
+		file = NAUTILUS_FILE (node->data);
+
+		if (file->details->directory == real_directory) {
+			g_hash_table_remove (pending_hash, file);
+			*pending = g_list_delete_link (*pending, node);
+			nautilus_file_unref (file);
+		}
+	}
+}
+
 static void
 merged_remove_real_directory (NautilusMergedDirectory *merged,
 			      NautilusDirectory *real_directory)
 {
+	gboolean was_loading;
+
 	g_return_if_fail (NAUTILUS_IS_MERGED_DIRECTORY (merged));
 	g_return_if_fail (NAUTILUS_IS_DIRECTORY (real_directory));
 	g_return_if_fail (g_list_find (merged->details->directories, real_directory) != NULL);
 
+	drop_pending_files (&merged->details->pending_added,
+			    merged->details->pending_added_hash,
+			    real_directory);
+	drop_pending_files (&merged->details->pending_changed,
+			    merged->details->pending_changed_hash,
+			    real_directory);
+
 	/* Since the real directory will be going away, act as if files were removed */
 	real_directory_notify_files_removed (real_directory);
 
@@ -575,9 +701,9 @@ merged_remove_real_directory (NautilusMergedDirectory *merged,
 	eel_g_hash_table_safe_for_each (merged->details->callbacks,
 					merged_callback_remove_directory_cover,
 					real_directory);
-	g_hash_table_foreach (merged->details->monitors,
-			      monitor_remove_directory,
-			      real_directory);
+	if (merged->details->monitoring) {
+		nautilus_directory_file_monitor_remove (real_directory, merged);
+	}
 
 	/* Disconnect all the signals. */
 	g_signal_handlers_disconnect_matched
@@ -587,9 +713,18 @@ merged_remove_real_directory (NautilusMergedDirectory *merged,
 	/* Remove from our list of directories. */
 	merged->details->directories = g_list_remove
 		(merged->details->directories, real_directory);
+	was_loading = g_list_find (merged->details->directories_not_done_loading,
+				   real_directory) != NULL;
 	merged->details->directories_not_done_loading = g_list_remove
 		(merged->details->directories_not_done_loading, real_directory);
 	nautilus_directory_unref (real_directory);
+
+	/* It may have been the last one still loading */
+	if (was_loading &&
+	    merged->details->directories_not_done_loading == NULL) {
+		forward_pending_files (merged);
+		nautilus_directory_emit_done_loading (NAUTILUS_DIRECTORY (merged));
+	}
 }
 
 void
@@ -606,14 +741,6 @@ nautilus_merged_directory_remove_real_directory (NautilusMergedDirectory *merged
 	g_signal_emit (merged, signals[REMOVE_REAL_DIRECTORY], 0, real_directory);
 }
 
-static void
-merged_monitor_destroy_cover (gpointer key,
-			      gpointer value,
-			      gpointer callback_data)
-{
-	merged_monitor_destroy (callback_data, value);
-}
-
 static void
 merged_callback_destroy_cover (gpointer key,
 			       gpointer value,
@@ -629,13 +756,21 @@ merged_finalize (GObject *object)
 
 	merged = NAUTILUS_MERGED_DIRECTORY (object);
 
-	g_hash_table_foreach (merged->details->monitors,
-			      merged_monitor_destroy_cover, merged);
+	g_hash_table_remove_all (merged->details->monitors);
+	update_real_monitors (merged);
 	g_hash_table_foreach (merged->details->callbacks,
 			      merged_callback_destroy_cover, NULL);
 
 	g_hash_table_destroy (merged->details->callbacks);
 	g_hash_table_destroy (merged->details->monitors);
+
+	if (merged->details->forward_idle_id != 0) {
+		g_source_remove (merged->details->forward_idle_id);
+	}
+	nautilus_file_list_free (merged->details->pending_added);
+	nautilus_file_list_free (merged->details->pending_changed);
+	g_hash_table_destroy (merged->details->pending_added_hash);
+	g_hash_table_destroy (merged->details->pending_changed_hash);
 	nautilus_directory_list_free (merged->details->directories);
 	g_list_free (merged->details->directories_not_done_loading);
 
@@ -649,7 +784,9 @@ nautilus_merged_directory_init (NautilusMergedDirectory *merged)
 						       NautilusMergedDirectoryDetails);
 	merged->details->callbacks = g_hash_table_new
 		(merged_callback_hash, merged_callback_equal);
-	merged->details->monitors = g_hash_table_new (NULL, NULL);
+	merged->details->monitors = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+	merged->details->pending_added_hash = g_hash_table_new (NULL, NULL);
+	merged->details->pending_changed_hash = g_hash_table_new (NULL, NULL);
 }
 
 static void
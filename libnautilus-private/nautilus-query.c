@@ -32,7 +32,9 @@
 struct NautilusQueryDetails {
 	char *text;
 	char *location_uri;
+	GList *other_location_uris;
 	GList *mime_types;
+	gboolean search_content;
 };
 
 static void  nautilus_query_class_init       (NautilusQueryClass *class);
@@ -48,6 +50,7 @@ finalize (GObject *object)
 	query = NAUTILUS_QUERY (object);
 	g_free (query->details->text);
 	g_free (query->details->location_uri);
+	g_list_free_full (query->details->other_location_uris, g_free);
 
 	G_OBJECT_CLASS (nautilus_query_parent_class)->finalize (object);
 }
@@ -103,6 +106,32 @@ nautilus_query_set_location (NautilusQuery *query, const char *uri)
 	query->details->location_uri = g_strdup (uri);
 }
 
+/* Returns the main location first, then the ones added to it */
+GList *
+nautilus_query_get_locations (NautilusQuery *query)
+{
+	GList *locations;
+
+	locations = eel_g_str_list_copy (query->details->other_location_uris);
+	if (query->details->location_uri != NULL) {
+		locations = g_list_prepend (locations, g_strdup (query->details->location_uri));
+	}
+
+	return locations;
+}
+
+void
+nautilus_query_add_location (NautilusQuery *query, const char *uri)
+{
+	if (query->details->location_uri == NULL) {
+		nautilus_query_set_location (query, uri);
+		return;
+	}
+
+	query->details->other_location_uris = g_list_append (query->details->other_location_uris,
+							     g_strdup (uri));
+}
+
 GList *
 nautilus_query_get_mime_types (NautilusQuery *query)
 {
@@ -123,6 +152,102 @@ nautilus_query_add_mime_type (NautilusQuery *query, const char *mime_type)
 						    g_strdup (mime_type));
 }
 
+gboolean
+nautilus_query_get_search_content (NautilusQuery *query)
+{
+	return query->details->search_content;
+}
+
+void
+nautilus_query_set_search_content (NautilusQuery *query, gboolean search_content)
+{
+	query->details->search_content = search_content;
+}
+
+static char **
+get_words (NautilusQuery *query)
+{
+	char *normalized, *lower;
+	char **words;
+
+	normalized = g_utf8_normalize (query->details->text != NULL ? query->details->text : "",
+				       -1, G_NORMALIZE_NFD);
+	lower = g_utf8_strdown (normalized, -1);
+	words = g_strsplit (lower, " ", -1);
+	g_free (lower);
+	g_free (normalized);
+
+	return words;
+}
+
+static gboolean
+str_list_contains (GList *list, const char *str)
+{
+	for (; list != NULL; list = list->next) {
+		if (strcmp (list->data, str) == 0) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* Returns TRUE if every file matching @query also matches @other,
+ * like when more characters were typed, a word was added, or mime
+ * types were dropped from the filter. File names match when they
+ * contain each word. Adding a mime filter where there was none is not
+ * a refinement: the hits found without one do not know their type.
+ */
+gboolean
+nautilus_query_is_refinement_of (NautilusQuery *query,
+				 NautilusQuery *other)
+{
+	char **words, **other_words;
+	gboolean found, refines;
+	GList *l;
+	int i, j;
+
+	if (g_strcmp0 (query->details->location_uri, other->details->location_uri) != 0 ||
+	    !eel_g_str_list_equal (query->details->other_location_uris,
+				   other->details->other_location_uris)) {
+		return FALSE;
+	}
+
+	/* Telling whether files still match would mean reading them again */
+	if (query->details->search_content || other->details->search_content) {
+		return FALSE;
+	}
+
+	if ((query->details->mime_types == NULL) != (other->details->mime_types == NULL)) {
+		return FALSE;
+	}
+
+	if (other->details->mime_types != NULL) {
+		for (l = query->details->mime_types; l != NULL; l = l->next) {
+			if (!str_list_contains (other->details->mime_types, l->data)) {
+				return FALSE;
+			}
+		}
+	}
+
+	words = get_words (query);
+	other_words = get_words (other);
+
+	refines = TRUE;
+	for (i = 0; refines && other_words[i] != NULL; i++) {
+		found = FALSE;
+		for (j = 0; !found && words[j] != NULL; j++) {
+			found = strstr (words[j], other_words[i]) != NULL;
+		}
+		refines = found;
+	}
+
+	g_strfreev (words);
+	g_strfreev (other_words);
+
+	return refines;
+}
+
 char *
 nautilus_query_to_readable_string (NautilusQuery *query)
 {
@@ -204,6 +329,8 @@ start_element_cb (GMarkupParseContext *ctx,
 		info->in_mimetypes = TRUE;
 	else if (strcmp (element_name, "mimetype") == 0)
 		info->in_mimetype = TRUE;
+	else if (strcmp (element_name, "content") == 0)
+		nautilus_query_set_search_content (info->query, TRUE);
 }
 
 static void
@@ -244,7 +371,7 @@ text_cb (GMarkupParseContext *ctx,
 		nautilus_query_set_text (info->query, t);
 	} else if (info->in_location) {
 		uri = decode_home_uri (t);
-		nautilus_query_set_location (info->query, uri);
+		nautilus_query_add_location (info->query, uri);
 		g_free (uri);
 	} else if (info->in_mimetypes && info->in_mimetype) {
 		nautilus_query_add_mime_type (info->query, t);
@@ -349,6 +476,12 @@ nautilus_query_to_xml (NautilusQuery *query)
 		g_free (uri);
 	}
 
+	for (l = query->details->other_location_uris; l != NULL; l = l->next) {
+		uri = encode_home_uri (l->data);
+		g_string_append_printf (xml, "   <location>%s</location>\n", uri);
+		g_free (uri);
+	}
+
 	if (query->details->mime_types) {
 		g_string_append (xml, "   <mimetypes>\n");
 		for (l = query->details->mime_types; l != NULL; l = l->next) {
@@ -358,6 +491,10 @@ nautilus_query_to_xml (NautilusQuery *query)
 		}
 		g_string_append (xml, "   </mimetypes>\n");
 	}
+
+	if (query->details->search_content) {
+		g_string_append (xml, "   <content/>\n");
+	}
 	
 	g_string_append (xml, "</query>\n");
 
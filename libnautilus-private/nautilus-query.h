@@ -55,10 +55,25 @@ void           nautilus_query_set_text           (NautilusQuery *query, const ch
 char *         nautilus_query_get_location       (NautilusQuery *query);
 void           nautilus_query_set_location       (NautilusQuery *query, const char *uri);
 
+/* A query can search several locations at once; the one set above is
+ * the main one, which relevance is measured from.
+ */
+GList *        nautilus_query_get_locations      (NautilusQuery *query);
+void           nautilus_query_add_location       (NautilusQuery *query, const char *uri);
+
 GList *        nautilus_query_get_mime_types     (NautilusQuery *query);
 void           nautilus_query_set_mime_types     (NautilusQuery *query, GList *mime_types);
 void           nautilus_query_add_mime_type      (NautilusQuery *query, const char *mime_type);
 
+/* Whether files whose contents match are found too, not only the
+ * ones whose names do.
+ */
+gboolean       nautilus_query_get_search_content (NautilusQuery *query);
+void           nautilus_query_set_search_content (NautilusQuery *query, gboolean search_content);
+
+gboolean       nautilus_query_is_refinement_of   (NautilusQuery *query,
+						  NautilusQuery *other);
+
 char *         nautilus_query_to_readable_string (NautilusQuery *query);
 NautilusQuery *nautilus_query_load               (char *file);
 gboolean       nautilus_query_save               (NautilusQuery *query, char *file);
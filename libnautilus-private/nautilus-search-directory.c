@@ -24,18 +24,23 @@
 #include "nautilus-search-directory.h"
 #include "nautilus-search-directory-file.h"
 
+#include "nautilus-directory-notify.h"
 #include "nautilus-directory-private.h"
 #include "nautilus-file.h"
 #include "nautilus-file-private.h"
 #include "nautilus-file-utilities.h"
 #include "nautilus-search-provider.h"
 #include "nautilus-search-engine.h"
+#include "nautilus-search-snapshot.h"
 #include <eel/eel-glib-extensions.h>
 #include <gtk/gtk.h>
 #include <gio/gio.h>
 #include <string.h>
 #include <sys/time.h>
 
+/* How many more results are shown each time */
+#define RESULTS_PAGE_SIZE 1000
+
 struct NautilusSearchDirectoryDetails {
 	NautilusQuery *query;
 	char *saved_search_uri;
@@ -47,7 +52,26 @@ struct NautilusSearchDirectoryDetails {
 	gboolean search_finished;
 
 	GList *files;
+	/* NautilusFile -> its link in files */
 	GHashTable *file_hash;
+	gulong file_changed_hook_id;
+	/* For reading the full info of files seeded from a hit */
+	GCancellable *file_info_cancellable;
+
+	/* Only the results_limit most relevant hits are shown; the
+	 * others are held back until more are asked for.
+	 */
+	GHashTable *shown_hits;
+	GPtrArray *shown_heap;
+	GHashTable *held_back_hits;
+	GPtrArray *held_back_heap;
+	guint results_limit;
+
+	/* Hits shown from the snapshot of a saved search that the
+	 * running search has not found again yet.
+	 */
+	GHashTable *snapshot_hits;
+	GCancellable *snapshot_cancellable;
 
 	GList *monitor_list;
 	GList *callback_list;
@@ -82,6 +106,8 @@ static void search_engine_finished (NautilusSearchEngine *engine, NautilusSearch
 static void search_engine_error (NautilusSearchEngine *engine, const char *error, NautilusSearchDirectory *search);
 static void search_callback_file_ready_callback (NautilusFile *file, gpointer data);
 static void file_changed (NautilusFile *file, NautilusSearchDirectory *search);
+static void reset_hits (NautilusSearchDirectory *search);
+static void load_snapshot (NautilusSearchDirectory *search);
 
 static void
 ensure_search_engine (NautilusSearchDirectory *search)
@@ -106,27 +132,25 @@ ensure_search_engine (NautilusSearchDirectory *search)
 static void
 reset_file_list (NautilusSearchDirectory *search)
 {
-	GList *list, *monitor_list;
-	NautilusFile *file;
+	GList *monitor_list;
 	SearchMonitor *monitor;
 
-	/* Remove file connections */
-	for (list = search->details->files; list != NULL; list = list->next) {
-		file = list->data;
-
-		/* Disconnect change handler */
-		g_signal_handlers_disconnect_by_func (file, file_changed, search);
-
-		/* Remove monitors */
-		for (monitor_list = search->details->monitor_list; monitor_list; 
-		     monitor_list = monitor_list->next) {
-			monitor = monitor_list->data;
-			nautilus_file_monitor_remove (file, monitor);
-		}
+	/* Remove monitors */
+	for (monitor_list = search->details->monitor_list; monitor_list; 
+	     monitor_list = monitor_list->next) {
+		monitor = monitor_list->data;
+		nautilus_file_list_monitor_remove (search->details->files, monitor);
 	}
-	
+
+	g_hash_table_remove_all (search->details->file_hash);
 	nautilus_file_list_free (search->details->files);
 	search->details->files = NULL;
+
+	g_cancellable_cancel (search->details->file_info_cancellable);
+	g_object_unref (search->details->file_info_cancellable);
+	search->details->file_info_cancellable = g_cancellable_new ();
+
+	reset_hits (search);
 }
 
 static void
@@ -143,6 +167,7 @@ start_or_stop_search_engine (NautilusSearchDirectory *search, gboolean adding)
 		nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (search->details->engine), search->details->query);
 
 		reset_file_list (search);
+		load_snapshot (search);
 
 		nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (search->details->engine));
 	} else if (!adding && (!search->details->monitor_list ||
@@ -168,6 +193,42 @@ file_changed (NautilusFile *file, NautilusSearchDirectory *search)
 	nautilus_directory_emit_files_changed (NAUTILUS_DIRECTORY (search), &list);
 }
 
+/* Rather than connecting to "changed" on each of possibly hundreds of
+ * thousands of hits, watch all emissions of it and pick ours.
+ */
+static gboolean
+file_changed_emission_hook (GSignalInvocationHint *ihint,
+			    guint n_param_values,
+			    const GValue *param_values,
+			    gpointer data)
+{
+	NautilusSearchDirectory *search;
+	NautilusFile *file;
+
+	search = data;
+	file = g_value_get_object (&param_values[0]);
+
+	if (g_hash_table_lookup (search->details->file_hash, file) != NULL) {
+		file_changed (file, search);
+	}
+
+	return TRUE;
+}
+
+static void
+ensure_file_changed_hook (NautilusSearchDirectory *search)
+{
+	guint signal_id;
+
+	if (search->details->file_changed_hook_id == 0) {
+		signal_id = g_signal_lookup ("changed", NAUTILUS_TYPE_FILE);
+		search->details->file_changed_hook_id =
+			g_signal_add_emission_hook (signal_id, 0,
+						    file_changed_emission_hook,
+						    search, NULL);
+	}
+}
+
 static void
 search_monitor_add (NautilusDirectory *directory,
 		    gconstpointer client,
@@ -176,10 +237,8 @@ search_monitor_add (NautilusDirectory *directory,
 		    NautilusDirectoryCallback callback,
 		    gpointer callback_data)
 {
-	GList *list;
 	SearchMonitor *monitor;
 	NautilusSearchDirectory *search;
-	NautilusFile *file;
 
 	search = NAUTILUS_SEARCH_DIRECTORY (directory);
 
@@ -194,12 +253,8 @@ search_monitor_add (NautilusDirectory *directory,
 		(* callback) (directory, search->details->files, callback_data);
 	}
 	
-	for (list = search->details->files; list != NULL; list = list->next) {
-		file = list->data;
-
-		/* Add monitors */
-		nautilus_file_monitor_add (file, monitor, file_attributes);
-	}
+	/* Add monitors */
+	nautilus_file_list_monitor_add (search->details->files, monitor, file_attributes);
 
 	start_or_stop_search_engine (search, TRUE);
 }
@@ -207,14 +262,7 @@ search_monitor_add (NautilusDirectory *directory,
 static void
 search_monitor_remove_file_monitors (SearchMonitor *monitor, NautilusSearchDirectory *search)
 {
-	GList *list;
-	NautilusFile *file;
-	
-	for (list = search->details->files; list != NULL; list = list->next) {
-		file = list->data;
-
-		nautilus_file_monitor_remove (file, monitor);
-	}
+	nautilus_file_list_monitor_remove (search->details->files, monitor);
 }
 
 static void
@@ -462,17 +510,369 @@ search_cancel_callback (NautilusDirectory *directory,
 
 
 static void
-search_engine_hits_added (NautilusSearchEngine *engine, GList *hits, 
-			  NautilusSearchDirectory *search)
+file_info_callback (GObject *source_object,
+		    GAsyncResult *res,
+		    gpointer user_data)
+{
+	NautilusFile *file;
+	GFileInfo *info;
+
+	file = NAUTILUS_FILE (user_data);
+
+	info = g_file_query_info_finish (G_FILE (source_object), res, NULL);
+	if (info != NULL) {
+		if (nautilus_file_update_info (file, info)) {
+			nautilus_file_changed (file);
+		}
+		g_object_unref (info);
+	}
+
+	nautilus_file_unref (file);
+}
+
+/* A file seeded from a hit has what the engine found it with, which
+ * is enough to show it. The rest, like permissions and metadata, is
+ * read here without holding the file back.
+ */
+static void
+read_full_file_info (NautilusSearchDirectory *search,
+		     NautilusFile *file)
+{
+	GFile *location;
+
+	location = nautilus_file_get_location (file);
+	g_file_query_info_async (location,
+				 NAUTILUS_FILE_DEFAULT_ATTRIBUTES,
+				 0,
+				 G_PRIORITY_LOW,
+				 search->details->file_info_cancellable,
+				 file_info_callback,
+				 nautilus_file_ref (file));
+	g_object_unref (location);
+}
+
+static void
+add_hit_files (NautilusSearchDirectory *search, GList *hits)
 {
 	GList *hit_list;
-	GList *file_list;
+	GList *file_list, *added;
 	NautilusFile *file;
+	GFileInfo *info;
 	SearchMonitor *monitor;
 	GList *monitor_list;
 
 	file_list = NULL;
 
+	ensure_file_changed_hook (search);
+
+	for (hit_list = hits; hit_list != NULL; hit_list = hit_list->next) {
+		NautilusSearchHit *hit = hit_list->data;
+
+		file = nautilus_file_get_by_uri (nautilus_search_hit_get_uri (hit));
+		nautilus_file_set_search_relevance (file, nautilus_search_hit_get_relevance (hit));
+
+		if (g_hash_table_lookup (search->details->file_hash, file) != NULL) {
+			nautilus_file_unref (file);
+			continue;
+		}
+
+		/* The engine read the info along with the hit; with it in
+		 * place the monitors added below do not read it again.
+		 */
+		info = nautilus_search_hit_get_file_info (hit);
+		if (info != NULL && !file->details->got_file_info) {
+			nautilus_file_update_info (file, info);
+
+			/* Snapshot hits are read when the engine finds
+			 * them again, see confirm_snapshot_hit().
+			 */
+			if (g_hash_table_lookup (search->details->snapshot_hits,
+						 nautilus_search_hit_get_uri (hit)) != hit) {
+				read_full_file_info (search, file);
+			}
+		}
+
+		file_list = g_list_prepend (file_list, file);
+		g_hash_table_insert (search->details->file_hash, file, file_list);
+	}
+
+	if (file_list == NULL) {
+		return;
+	}
+
+	for (monitor_list = search->details->monitor_list; monitor_list; monitor_list = monitor_list->next) {
+		monitor = monitor_list->data;
+
+		/* Add monitors */
+		nautilus_file_list_monitor_add (file_list, monitor, monitor->monitor_attributes);
+	}
+
+	/* The new files go in front; the order does not matter, and
+	 * this way adding them does not walk all the files found so far.
+	 */
+	added = g_list_copy (file_list);
+	search->details->files = g_list_concat (file_list, search->details->files);
+
+	nautilus_directory_emit_files_added (NAUTILUS_DIRECTORY (search), added);
+	g_list_free (added);
+}
+
+static void
+remove_hit_files (NautilusSearchDirectory *search, GList *hits)
+{
+	GList *hit_list;
+	GList *monitor_list;
+	SearchMonitor *monitor;
+	GList *file_list, *link;
+	NautilusFile *file;
+
+	file_list = NULL;
+
+	for (hit_list = hits; hit_list != NULL; hit_list = hit_list->next) {
+		NautilusSearchHit *hit = hit_list->data;
+
+		file = nautilus_file_get_existing_by_uri (nautilus_search_hit_get_uri (hit));
+		if (file == NULL) {
+			continue;
+		}
+
+		link = g_hash_table_lookup (search->details->file_hash, file);
+		if (link == NULL) {
+			nautilus_file_unref (file);
+			continue;
+		}
+
+		g_hash_table_remove (search->details->file_hash, file);
+		search->details->files = g_list_delete_link (search->details->files, link);
+		nautilus_file_unref (file);
+
+		file_list = g_list_prepend (file_list, file);
+	}
+
+	if (file_list == NULL) {
+		return;
+	}
+
+	for (monitor_list = search->details->monitor_list; monitor_list; 
+	     monitor_list = monitor_list->next) {
+		monitor = monitor_list->data;
+		/* Remove monitors */
+		nautilus_file_list_monitor_remove (file_list, monitor);
+	}
+	
+	nautilus_directory_emit_files_changed (NAUTILUS_DIRECTORY (search), file_list);
+
+	nautilus_file_list_free (file_list);
+}
+
+/* Binary heaps of hits, ordered by relevance: the least relevant hit
+ * is on top of the shown heap, the most relevant one on top of the
+ * held back heap. Hits are not taken out of a heap when they are
+ * subtracted, only out of the matching hash table, and are skipped
+ * once they come to the top.
+ */
+static gboolean
+hit_heap_before (GPtrArray *heap, guint a, guint b, gboolean max_heap)
+{
+	gdouble relevance_a, relevance_b;
+
+	relevance_a = nautilus_search_hit_get_relevance (g_ptr_array_index (heap, a));
+	relevance_b = nautilus_search_hit_get_relevance (g_ptr_array_index (heap, b));
+
+	return max_heap ? relevance_a > relevance_b : relevance_a < relevance_b;
+}
+
+static void
+hit_heap_swap (GPtrArray *heap, guint a, guint b)
+{
+	gpointer tmp;
+
+	tmp = heap->pdata[a];
+	heap->pdata[a] = heap->pdata[b];
+	heap->pdata[b] = tmp;
+}
+
+static void
+hit_heap_push (GPtrArray *heap, NautilusSearchHit *hit, gboolean max_heap)
+{
+	guint i, parent;
+
+	g_ptr_array_add (heap, g_object_ref (hit));
+
+	for (i = heap->len - 1; i > 0; i = parent) {
+		parent = (i - 1) / 2;
+		if (!hit_heap_before (heap, i, parent, max_heap)) {
+			break;
+		}
+		hit_heap_swap (heap, i, parent);
+	}
+}
+
+/* Returns the top of the heap, with its reference */
+static NautilusSearchHit *
+hit_heap_pop (GPtrArray *heap, gboolean max_heap)
+{
+	NautilusSearchHit *hit;
+	guint i, child;
+
+	if (heap->len == 0) {
+		return NULL;
+	}
+
+	hit = g_ptr_array_index (heap, 0);
+	heap->pdata[0] = heap->pdata[heap->len - 1];
+	g_ptr_array_set_size (heap, heap->len - 1);
+
+	for (i = 0; (child = 2 * i + 1) < heap->len; i = child) {
+		if (child + 1 < heap->len &&
+		    hit_heap_before (heap, child + 1, child, max_heap)) {
+			child++;
+		}
+		if (!hit_heap_before (heap, child, i, max_heap)) {
+			break;
+		}
+		hit_heap_swap (heap, i, child);
+	}
+
+	return hit;
+}
+
+/* Drops subtracted hits from the top of @heap and returns the top */
+static NautilusSearchHit *
+hit_heap_peek (GPtrArray *heap, GHashTable *hits, gboolean max_heap)
+{
+	NautilusSearchHit *hit;
+
+	while (heap->len > 0) {
+		hit = g_ptr_array_index (heap, 0);
+		if (g_hash_table_lookup (hits, nautilus_search_hit_get_uri (hit)) == hit) {
+			return hit;
+		}
+		g_object_unref (hit_heap_pop (heap, max_heap));
+	}
+
+	return NULL;
+}
+
+static void
+show_hit (NautilusSearchDirectory *search, NautilusSearchHit *hit)
+{
+	g_hash_table_insert (search->details->shown_hits,
+			     (char *) nautilus_search_hit_get_uri (hit),
+			     g_object_ref (hit));
+	hit_heap_push (search->details->shown_heap, hit, FALSE);
+}
+
+static void
+hold_back_hit (NautilusSearchDirectory *search, NautilusSearchHit *hit)
+{
+	g_hash_table_insert (search->details->held_back_hits,
+			     (char *) nautilus_search_hit_get_uri (hit),
+			     g_object_ref (hit));
+	hit_heap_push (search->details->held_back_heap, hit, TRUE);
+}
+
+/* Shows the most relevant held back hits until the limit is reached */
+static void
+show_held_back_hits (NautilusSearchDirectory *search)
+{
+	NautilusSearchHit *hit;
+	GList *shown;
+
+	shown = NULL;
+	while (g_hash_table_size (search->details->shown_hits) < search->details->results_limit &&
+	       (hit = hit_heap_peek (search->details->held_back_heap,
+				     search->details->held_back_hits, TRUE)) != NULL) {
+		hit = hit_heap_pop (search->details->held_back_heap, TRUE);
+		g_hash_table_remove (search->details->held_back_hits,
+				     nautilus_search_hit_get_uri (hit));
+		show_hit (search, hit);
+		shown = g_list_prepend (shown, hit);
+	}
+
+	add_hit_files (search, shown);
+	g_list_free_full (shown, g_object_unref);
+}
+
+static gboolean
+hit_is_in_file_list (NautilusSearchDirectory *search, NautilusSearchHit *hit)
+{
+	NautilusFile *file;
+	gboolean found;
+
+	file = nautilus_file_get_existing_by_uri (nautilus_search_hit_get_uri (hit));
+	if (file == NULL) {
+		return FALSE;
+	}
+
+	found = g_hash_table_lookup (search->details->file_hash, file) != NULL;
+	nautilus_file_unref (file);
+
+	return found;
+}
+
+static void
+reset_hits (NautilusSearchDirectory *search)
+{
+	if (search->details->snapshot_cancellable != NULL) {
+		g_cancellable_cancel (search->details->snapshot_cancellable);
+		g_object_unref (search->details->snapshot_cancellable);
+		search->details->snapshot_cancellable = NULL;
+	}
+	g_hash_table_remove_all (search->details->snapshot_hits);
+	g_hash_table_remove_all (search->details->shown_hits);
+	g_hash_table_remove_all (search->details->held_back_hits);
+	g_ptr_array_set_size (search->details->shown_heap, 0);
+	g_ptr_array_set_size (search->details->held_back_heap, 0);
+	search->details->results_limit = RESULTS_PAGE_SIZE;
+}
+
+/* The engine found a hit that was shown from the snapshot. The info
+ * it found it with replaces the saved one on the hit, and a shown file
+ * is read again, see add_hit_files().
+ */
+static void
+confirm_snapshot_hit (NautilusSearchDirectory *search,
+		      NautilusSearchHit *hit)
+{
+	NautilusSearchHit *snapshot_hit;
+	NautilusFile *file;
+	GFileInfo *info;
+
+	snapshot_hit = g_hash_table_lookup (search->details->snapshot_hits,
+					    nautilus_search_hit_get_uri (hit));
+	if (snapshot_hit == NULL) {
+		return;
+	}
+
+	info = nautilus_search_hit_get_file_info (hit);
+	if (info != NULL) {
+		nautilus_search_hit_set_file_info (snapshot_hit, info);
+	}
+
+	file = nautilus_file_get_existing_by_uri (nautilus_search_hit_get_uri (hit));
+	if (file != NULL &&
+	    g_hash_table_lookup (search->details->file_hash, file) != NULL) {
+		read_full_file_info (search, file);
+	}
+	nautilus_file_unref (file);
+
+	g_hash_table_remove (search->details->snapshot_hits,
+			     nautilus_search_hit_get_uri (hit));
+}
+
+static void
+search_engine_hits_added (NautilusSearchEngine *engine, GList *hits, 
+			  NautilusSearchDirectory *search)
+{
+	GList *hit_list;
+	GList *shown, *hidden, *link, *next;
+	NautilusSearchHit *least;
+	NautilusFile *file;
+
+	shown = NULL;
+	hidden = NULL;
+
 	for (hit_list = hits; hit_list != NULL; hit_list = hit_list->next) {
 		NautilusSearchHit *hit = hit_list->data;
 		const char *uri;
@@ -483,26 +883,62 @@ search_engine_hits_added (NautilusSearchEngine *engine, GList *hits,
 			continue;
 		}
 
-		nautilus_search_hit_compute_scores (hit, search->details->query);
+		if (engine != NULL) {
+			confirm_snapshot_hit (search, hit);
+		}
 
-		file = nautilus_file_get_by_uri (uri);
-		nautilus_file_set_search_relevance (file, nautilus_search_hit_get_relevance (hit));
+		if (g_hash_table_lookup (search->details->shown_hits, uri) != NULL ||
+		    g_hash_table_lookup (search->details->held_back_hits, uri) != NULL) {
+			continue;
+		}
 
-		for (monitor_list = search->details->monitor_list; monitor_list; monitor_list = monitor_list->next) {
-			monitor = monitor_list->data;
+		if (g_hash_table_size (search->details->shown_hits) < search->details->results_limit) {
+			show_hit (search, hit);
+			shown = g_list_prepend (shown, hit);
+			continue;
+		}
 
-			/* Add monitors */
-			nautilus_file_monitor_add (file, monitor, monitor->monitor_attributes);
+		least = hit_heap_peek (search->details->shown_heap,
+				       search->details->shown_hits, FALSE);
+		if (least == NULL ||
+		    nautilus_search_hit_get_relevance (hit) <= nautilus_search_hit_get_relevance (least)) {
+			hold_back_hit (search, hit);
+			continue;
 		}
 
-		g_signal_connect (file, "changed", G_CALLBACK (file_changed), search),
+		/* Make room by holding back the least relevant shown hit */
+		least = hit_heap_pop (search->details->shown_heap, FALSE);
+		g_hash_table_remove (search->details->shown_hits,
+				     nautilus_search_hit_get_uri (least));
+		hold_back_hit (search, least);
 
-		file_list = g_list_prepend (file_list, file);
+		/* Hits shown in an earlier batch have their file in
+		 * the list; the ones from this batch are dropped from
+		 * shown below.
+		 */
+		if (hit_is_in_file_list (search, least)) {
+			hidden = g_list_prepend (hidden, least);
+		} else {
+			g_object_unref (least);
+		}
+
+		show_hit (search, hit);
+		shown = g_list_prepend (shown, hit);
+	}
+
+	remove_hit_files (search, hidden);
+	g_list_free_full (hidden, g_object_unref);
+
+	for (link = shown; link != NULL; link = next) {
+		next = link->next;
+		if (g_hash_table_lookup (search->details->shown_hits,
+					 nautilus_search_hit_get_uri (link->data)) != link->data) {
+			shown = g_list_delete_link (shown, link);
+		}
 	}
-	
-	search->details->files = g_list_concat (search->details->files, file_list);
 
-	nautilus_directory_emit_files_added (NAUTILUS_DIRECTORY (search), file_list);
+	add_hit_files (search, shown);
+	g_list_free (shown);
 
 	file = nautilus_directory_get_corresponding_file (NAUTILUS_DIRECTORY (search));
 	nautilus_file_emit_changed (file);
@@ -514,37 +950,31 @@ search_engine_hits_subtracted (NautilusSearchEngine *engine, GList *hits,
 			       NautilusSearchDirectory *search)
 {
 	GList *hit_list;
-	GList *monitor_list;
-	SearchMonitor *monitor;
-	GList *file_list;
+	GList *hidden;
 	NautilusFile *file;
 
-	file_list = NULL;
+	hidden = NULL;
 
 	for (hit_list = hits; hit_list != NULL; hit_list = hit_list->next) {
 		NautilusSearchHit *hit = hit_list->data;
 		const char *uri;
 
 		uri = nautilus_search_hit_get_uri (hit);
-		file = nautilus_file_get_by_uri (uri);
-
-		for (monitor_list = search->details->monitor_list; monitor_list; 
-		     monitor_list = monitor_list->next) {
-			monitor = monitor_list->data;
-			/* Remove monitors */
-			nautilus_file_monitor_remove (file, monitor);
+		if (g_hash_table_remove (search->details->held_back_hits, uri)) {
+			continue;
 		}
-		
-		g_signal_handlers_disconnect_by_func (file, file_changed, search);
 
-		search->details->files = g_list_remove (search->details->files, file);
-
-		file_list = g_list_prepend (file_list, file);
+		if (g_hash_table_lookup (search->details->shown_hits, uri) != NULL) {
+			hidden = g_list_prepend (hidden, hit);
+			g_hash_table_remove (search->details->shown_hits, uri);
+		}
 	}
-	
-	nautilus_directory_emit_files_changed (NAUTILUS_DIRECTORY (search), file_list);
 
-	nautilus_file_list_free (file_list);
+	remove_hit_files (search, hidden);
+	g_list_free (hidden);
+
+	/* Fill the room that was made */
+	show_held_back_hits (search);
 
 	file = nautilus_directory_get_corresponding_file (NAUTILUS_DIRECTORY (search));
 	nautilus_file_emit_changed (file);
@@ -572,9 +1002,114 @@ search_engine_error (NautilusSearchEngine *engine, const char *error_message, Na
 	g_error_free (error);
 }
 
+static void
+snapshot_loaded (GObject *source_object,
+		 GAsyncResult *res,
+		 gpointer user_data)
+{
+	NautilusSearchDirectory *search;
+	GList *hits, *added, *l;
+	const char *uri;
+	GError *error;
+
+	search = NAUTILUS_SEARCH_DIRECTORY (user_data);
+	error = NULL;
+	hits = nautilus_search_snapshot_load_finish (res, &error);
+
+	/* When cancelled, the search the snapshot was for is over */
+	if (error != NULL) {
+		g_error_free (error);
+		nautilus_directory_unref (NAUTILUS_DIRECTORY (search));
+		return;
+	}
+
+	g_clear_object (&search->details->snapshot_cancellable);
+
+	/* Files are only made for the hits that get shown, and seeded
+	 * with the snapshot info then, see add_hit_files().
+	 */
+	added = NULL;
+	for (l = hits; l != NULL; l = l->next) {
+		NautilusSearchHit *hit = l->data;
+
+		/* The search may have found some of them already */
+		uri = nautilus_search_hit_get_uri (hit);
+		if (g_hash_table_lookup (search->details->shown_hits, uri) != NULL ||
+		    g_hash_table_lookup (search->details->held_back_hits, uri) != NULL) {
+			continue;
+		}
+
+		g_hash_table_insert (search->details->snapshot_hits,
+				     (char *) uri, g_object_ref (hit));
+		added = g_list_prepend (added, hit);
+	}
+
+	if (added != NULL) {
+		search_engine_hits_added (NULL, added, search);
+	}
+
+	g_list_free (added);
+	g_list_free_full (hits, g_object_unref);
+	nautilus_directory_unref (NAUTILUS_DIRECTORY (search));
+}
+
+/* Shows the results a saved search had last time while it runs again */
+static void
+load_snapshot (NautilusSearchDirectory *search)
+{
+	if (search->details->saved_search_uri == NULL ||
+	    search->details->modified ||
+	    !nautilus_search_snapshot_is_enabled ()) {
+		return;
+	}
+
+	search->details->snapshot_cancellable = g_cancellable_new ();
+	nautilus_search_snapshot_load_async (search->details->saved_search_uri,
+					     search->details->query,
+					     search->details->snapshot_cancellable,
+					     snapshot_loaded,
+					     nautilus_directory_ref (NAUTILUS_DIRECTORY (search)));
+}
+
+static void
+save_snapshot (NautilusSearchDirectory *search)
+{
+	GList *hits;
+
+	if (search->details->saved_search_uri == NULL ||
+	    search->details->modified ||
+	    !nautilus_search_snapshot_is_enabled ()) {
+		return;
+	}
+
+	hits = g_list_concat (g_hash_table_get_values (search->details->shown_hits),
+			      g_hash_table_get_values (search->details->held_back_hits));
+	nautilus_search_snapshot_save (search->details->saved_search_uri,
+				       search->details->query,
+				       hits);
+	g_list_free (hits);
+}
+
 static void
 search_engine_finished (NautilusSearchEngine *engine, NautilusSearchDirectory *search)
 {
+	GList *gone;
+
+	/* The snapshot hits that were not found again are gone */
+	if (search->details->snapshot_cancellable != NULL) {
+		g_cancellable_cancel (search->details->snapshot_cancellable);
+		g_clear_object (&search->details->snapshot_cancellable);
+	}
+	gone = g_hash_table_get_values (search->details->snapshot_hits);
+	g_list_foreach (gone, (GFunc) g_object_ref, NULL);
+	g_hash_table_remove_all (search->details->snapshot_hits);
+	if (gone != NULL) {
+		search_engine_hits_subtracted (engine, gone, search);
+	}
+	g_list_free_full (gone, g_object_unref);
+
+	save_snapshot (search);
+
 	search->details->search_finished = TRUE;
 
 	nautilus_directory_emit_done_loading (NAUTILUS_DIRECTORY (search));
@@ -634,8 +1169,7 @@ search_contains_file (NautilusDirectory *directory,
 
 	search = NAUTILUS_SEARCH_DIRECTORY (directory);
 
-	/* FIXME: Maybe put the files in a hash */
-	return (g_list_find (search->details->files, file) != NULL);
+	return g_hash_table_lookup (search->details->file_hash, file) != NULL;
 }
 
 static GList *
@@ -662,6 +1196,12 @@ search_dispose (GObject *object)
 	GList *list;
 
 	search = NAUTILUS_SEARCH_DIRECTORY (object);
+
+	if (search->details->file_changed_hook_id != 0) {
+		g_signal_remove_emission_hook (g_signal_lookup ("changed", NAUTILUS_TYPE_FILE),
+					       search->details->file_changed_hook_id);
+		search->details->file_changed_hook_id = 0;
+	}
 	
 	/* Remove search monitors */
 	if (search->details->monitor_list) {
@@ -715,6 +1255,13 @@ search_finalize (GObject *object)
 	search = NAUTILUS_SEARCH_DIRECTORY (object);
 
 	g_free (search->details->saved_search_uri);
+	g_hash_table_destroy (search->details->file_hash);
+	g_hash_table_destroy (search->details->shown_hits);
+	g_hash_table_destroy (search->details->held_back_hits);
+	g_hash_table_destroy (search->details->snapshot_hits);
+	g_object_unref (search->details->file_info_cancellable);
+	g_ptr_array_free (search->details->shown_heap, TRUE);
+	g_ptr_array_free (search->details->held_back_heap, TRUE);
 	
 	g_free (search->details);
 
@@ -725,6 +1272,17 @@ static void
 nautilus_search_directory_init (NautilusSearchDirectory *search)
 {
 	search->details = g_new0 (NautilusSearchDirectoryDetails, 1);
+	search->details->file_hash = g_hash_table_new (NULL, NULL);
+	search->details->file_info_cancellable = g_cancellable_new ();
+	search->details->shown_hits = g_hash_table_new_full (g_str_hash, g_str_equal,
+							     NULL, g_object_unref);
+	search->details->shown_heap = g_ptr_array_new_with_free_func (g_object_unref);
+	search->details->held_back_hits = g_hash_table_new_full (g_str_hash, g_str_equal,
+								 NULL, g_object_unref);
+	search->details->held_back_heap = g_ptr_array_new_with_free_func (g_object_unref);
+	search->details->snapshot_hits = g_hash_table_new_full (g_str_hash, g_str_equal,
+								NULL, g_object_unref);
+	search->details->results_limit = RESULTS_PAGE_SIZE;
 }
 
 static void
@@ -790,6 +1348,69 @@ nautilus_search_directory_set_query (NautilusSearchDirectory *search,
 	}
 }
 
+/* Narrows the running search down to @query without starting it
+ * over, when @query only matches files the current query matches too.
+ * The results that no longer match come back from the engine as
+ * hits-subtracted, and their files are removed. Returns
+ * FALSE if the search has to be reloaded with @query instead.
+ */
+gboolean
+nautilus_search_directory_refine_query (NautilusSearchDirectory *search,
+					NautilusQuery *query)
+{
+	if (!search->details->search_running ||
+	    search->details->engine == NULL ||
+	    search->details->query == NULL ||
+	    query == NULL) {
+		return FALSE;
+	}
+
+	if (!nautilus_query_is_refinement_of (query, search->details->query)) {
+		return FALSE;
+	}
+
+	if (!nautilus_search_provider_refine_query (NAUTILUS_SEARCH_PROVIDER (search->details->engine),
+						    query)) {
+		return FALSE;
+	}
+
+	nautilus_search_directory_set_query (search, query);
+
+	return TRUE;
+}
+
+/* Whether less relevant results than the shown ones were found */
+gboolean
+nautilus_search_directory_has_more_results (NautilusSearchDirectory *search)
+{
+	return hit_heap_peek (search->details->held_back_heap,
+			      search->details->held_back_hits, TRUE) != NULL;
+}
+
+/* Whether the search finished without looking everywhere, because
+ * it ran out of time or files to look at on some file systems.
+ */
+gboolean
+nautilus_search_directory_is_incomplete (NautilusSearchDirectory *search)
+{
+	return search->details->search_finished &&
+		nautilus_search_engine_is_incomplete (search->details->engine);
+}
+
+/* Shows the next page of held back results, most relevant first */
+void
+nautilus_search_directory_load_more_results (NautilusSearchDirectory *search)
+{
+	NautilusFile *file;
+
+	search->details->results_limit += RESULTS_PAGE_SIZE;
+	show_held_back_hits (search);
+
+	file = nautilus_directory_get_corresponding_file (NAUTILUS_DIRECTORY (search));
+	nautilus_file_emit_changed (file);
+	nautilus_file_unref (file);
+}
+
 NautilusQuery *
 nautilus_search_directory_get_query (NautilusSearchDirectory *search)
 {
@@ -66,5 +66,11 @@ void           nautilus_search_directory_save_to_file    (NautilusSearchDirector
 NautilusQuery *nautilus_search_directory_get_query       (NautilusSearchDirectory *search);
 void           nautilus_search_directory_set_query       (NautilusSearchDirectory *search,
 							  NautilusQuery           *query);
+gboolean       nautilus_search_directory_refine_query    (NautilusSearchDirectory *search,
+							  NautilusQuery           *query);
+
+gboolean       nautilus_search_directory_has_more_results  (NautilusSearchDirectory *search);
+void           nautilus_search_directory_load_more_results (NautilusSearchDirectory *search);
+gboolean       nautilus_search_directory_is_incomplete     (NautilusSearchDirectory *search);
 
 #endif /* NAUTILUS_SEARCH_DIRECTORY_H */
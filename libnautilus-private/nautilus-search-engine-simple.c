@@ -22,43 +22,145 @@
  */
 
 #include <config.h>
+#include "nautilus-file-private.h"
+#include "nautilus-global-preferences.h"
 #include "nautilus-search-hit.h"
+#include "nautilus-search-matcher.h"
 #include "nautilus-search-provider.h"
 #include "nautilus-search-engine-simple.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
 #include <string.h>
+#include <unistd.h>
 #include <glib.h>
 #include <gio/gio.h>
 
 #define BATCH_SIZE 500
 
+/* Files larger than this are not read when searching contents */
+#define CONTENT_SEARCH_MAX_SIZE (16 * 1024 * 1024)
+/* A NUL byte in this many first bytes makes a file binary */
+#define CONTENT_SNIFF_SIZE 4096
+/* Files are read this much at a time, at least CONTENT_SNIFF_SIZE */
+#define CONTENT_CHUNK_SIZE (64 * 1024)
+#define CONTENT_SEARCH_MAX_THREADS 4
+/* Locations beyond this many share the crawl threads */
+#define CRAWL_MAX_THREADS 4
+
 enum {
 	PROP_RECURSIVE = 1,
 	NUM_PROPERTIES
 };
 
+/* A hit along with what it was matched on, so that it can be matched
+ * again when the query is refined.
+ */
+typedef struct {
+	NautilusSearchHit *hit;
+	char *name;
+	char *mime_type;
+	guint generation;
+} SimpleHit;
+
+/* What names and types are matched with. It is not changed once
+ * made: refining the query puts a new one with the next generation in
+ * its place, and each crawl thread keeps the one it holds until it
+ * sees that the generation changed.
+ */
+typedef struct {
+	gint ref_count;
+	guint generation;
+	char **words;
+	NautilusSearchMatcher *name_matcher; /* for words */
+	GList *mime_types;
+} SearchFilter;
+
 typedef struct {
 	NautilusSearchEngineSimple *engine;
 	GCancellable *cancellable;
 
-	GList *mime_types;
-	char **words;
+	/* Protects filter, which is replaced from the main thread when
+	 * the query is refined, and hits, which the content readers add to.
+	 */
+	GMutex lock;
+	SearchFilter *filter;
+	/* The generation of filter, read without the lock */
+	gint generation;
 	GList *found_list;
 
-	GQueue *directories; /* GFiles */
+	NautilusSearchHitScorer *scorer;
+
+	/* Only set when file contents are searched too */
+	NautilusSearchMatcher *content_matcher;
+	GThreadPool *content_pool;
+
+	GList *locations; /* uris */
+
+	/* Protects roots, next_root, n_busy, visited, mounts and the
+	 * crawl counts of the mounts, and incomplete, which the crawl
+	 * threads share.
+	 */
+	GMutex crawl_lock;
+	GCond crawl_cond;
+	GPtrArray *roots; /* GQueues of CrawlDirectories, one per location */
+	guint next_root;
+	int n_busy;
 
 	GHashTable *visited;
 
+	/* Where not to descend, from the preferences */
+	gboolean stay_on_filesystem;
+	gboolean skip_remote_mounts;
+	GPtrArray *ignore_patterns; /* GPatternSpecs */
+	int max_depth;
+	gint64 mount_time_budget;
+	guint mount_entry_budget;
+
+	GHashTable *mounts; /* id::filesystem -> CrawlMount */
+	/* Set when some budget ran out, so not everything was searched */
+	gboolean incomplete;
+
 	gboolean recursive;
 	gint n_processed_files;
 	GList *hits;
 } SearchThreadData;
 
+/* A file system met during the crawl */
+typedef struct {
+	gboolean skip;
+	gboolean exhausted;
+	gint64 time_spent;
+	guint n_entries;
+} CrawlMount;
+
+typedef struct {
+	GFile *dir;
+	CrawlMount *mount;
+	int depth;
+	guint root;
+} CrawlDirectory;
+
+/* A file whose name did not match, to be read by a content reader */
+typedef struct {
+	GFile *file;
+	char *path;
+	char *name;
+	char *mime_type;
+	GFileInfo *info;
+	guint generation;
+} ContentJob;
+
 
 struct NautilusSearchEngineSimpleDetails {
 	NautilusQuery *query;
 
 	SearchThreadData *active_search;
+	gboolean incomplete;
+
+	/* uri -> SimpleHit, for everything reported since the start */
+	GHashTable *hits;
 
 	gboolean recursive;
 	gboolean query_finished;
@@ -67,6 +169,10 @@ struct NautilusSearchEngineSimpleDetails {
 static GParamSpec *properties[NUM_PROPERTIES] = { NULL, };
 
 static void nautilus_search_provider_init (NautilusSearchProviderIface  *iface);
+static void search_content_func (gpointer job_data,
+				 gpointer user_data);
+static void nautilus_search_engine_simple_set_query (NautilusSearchProvider *provider,
+						     NautilusQuery          *query);
 
 G_DEFINE_TYPE_WITH_CODE (NautilusSearchEngineSimple,
 			 nautilus_search_engine_simple,
@@ -80,6 +186,10 @@ finalize (GObject *object)
 	NautilusSearchEngineSimple *simple;
 
 	simple = NAUTILUS_SEARCH_ENGINE_SIMPLE (object);
+
+	if (simple->details->hits != NULL) {
+		g_hash_table_destroy (simple->details->hits);
+	}
 	
 	if (simple->details->query) {
 		g_object_unref (simple->details->query);
@@ -89,39 +199,251 @@ finalize (GObject *object)
 	G_OBJECT_CLASS (nautilus_search_engine_simple_parent_class)->finalize (object);
 }
 
+static void
+simple_hit_free (SimpleHit *simple_hit)
+{
+	g_object_unref (simple_hit->hit);
+	g_free (simple_hit->name);
+	g_free (simple_hit->mime_type);
+	g_slice_free (SimpleHit, simple_hit);
+}
+
+static char **
+get_query_words (NautilusQuery *query)
+{
+	char *text, *lower, *normalized;
+	char **words;
+
+	text = nautilus_query_get_text (query);
+	normalized = g_utf8_normalize (text, -1, G_NORMALIZE_NFD);
+	lower = g_utf8_strdown (normalized, -1);
+	words = g_strsplit (lower, " ", -1);
+	g_free (text);
+	g_free (lower);
+	g_free (normalized);
+
+	return words;
+}
+
+static gboolean
+matches_mime_type (const char *mime_type,
+		   GList *mime_types)
+{
+	GList *l;
+
+	if (mime_types == NULL) {
+		return TRUE;
+	}
+
+	for (l = mime_types; mime_type != NULL && l != NULL; l = l->next) {
+		if (g_content_type_equals (mime_type, l->data)) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* @name is the normalized, lowercase display name */
+static gboolean
+matches (const char *name,
+	 const char *mime_type,
+	 char **words,
+	 GList *mime_types)
+{
+	int i;
+
+	for (i = 0; words[i] != NULL; i++) {
+		if (strstr (name, words[i]) == NULL) {
+			return FALSE;
+		}
+	}
+
+	return matches_mime_type (mime_type, mime_types);
+}
+
+/* Takes over @words and @mime_types */
+static SearchFilter *
+search_filter_new (char **words,
+		   GList *mime_types,
+		   guint generation)
+{
+	SearchFilter *filter;
+
+	filter = g_slice_new (SearchFilter);
+	filter->ref_count = 1;
+	filter->generation = generation;
+	filter->words = words;
+	filter->name_matcher = nautilus_search_matcher_new (words);
+	filter->mime_types = mime_types;
+
+	return filter;
+}
+
+static void
+search_filter_unref (SearchFilter *filter)
+{
+	if (!g_atomic_int_dec_and_test (&filter->ref_count)) {
+		return;
+	}
+
+	nautilus_search_matcher_free (filter->name_matcher);
+	g_strfreev (filter->words);
+	g_list_free_full (filter->mime_types, g_free);
+	g_slice_free (SearchFilter, filter);
+}
+
+static SearchFilter *
+get_filter (SearchThreadData *data)
+{
+	SearchFilter *filter;
+
+	g_mutex_lock (&data->lock);
+	filter = data->filter;
+	g_atomic_int_inc (&filter->ref_count);
+	g_mutex_unlock (&data->lock);
+
+	return filter;
+}
+
+/* File contents are mostly composed, unlike the names matched above */
+static NautilusSearchMatcher *
+get_content_matcher (NautilusQuery *query)
+{
+	NautilusSearchMatcher *matcher;
+	char *text, *lower, *normalized;
+	char **words;
+
+	text = nautilus_query_get_text (query);
+	normalized = g_utf8_normalize (text, -1, G_NORMALIZE_NFC);
+	lower = g_utf8_strdown (normalized, -1);
+	words = g_strsplit (lower, " ", -1);
+	matcher = nautilus_search_matcher_new (words);
+	g_strfreev (words);
+	g_free (text);
+	g_free (lower);
+	g_free (normalized);
+
+	if (nautilus_search_matcher_get_n_words (matcher) == 0) {
+		nautilus_search_matcher_free (matcher);
+		return NULL;
+	}
+
+	return matcher;
+}
+
+static int
+get_n_content_threads (void)
+{
+	long n;
+
+	n = sysconf (_SC_NPROCESSORS_ONLN);
+
+	return CLAMP (n, 1, CONTENT_SEARCH_MAX_THREADS);
+}
+
+static CrawlDirectory *
+crawl_directory_new (GFile *dir,
+		     CrawlMount *mount,
+		     int depth,
+		     guint root)
+{
+	CrawlDirectory *crawl_dir;
+
+	crawl_dir = g_slice_new (CrawlDirectory);
+	crawl_dir->dir = dir;
+	crawl_dir->mount = mount;
+	crawl_dir->depth = depth;
+	crawl_dir->root = root;
+
+	return crawl_dir;
+}
+
+static void
+crawl_directory_free (CrawlDirectory *crawl_dir)
+{
+	g_object_unref (crawl_dir->dir);
+	g_slice_free (CrawlDirectory, crawl_dir);
+}
+
+static void
+crawl_root_free (GQueue *root)
+{
+	g_queue_free_full (root, (GDestroyNotify) crawl_directory_free);
+}
+
+static void
+crawl_mount_free (CrawlMount *mount)
+{
+	g_slice_free (CrawlMount, mount);
+}
+
+static void
+read_crawl_preferences (SearchThreadData *data)
+{
+	char **patterns;
+	int i;
+
+	data->stay_on_filesystem = g_settings_get_boolean (nautilus_preferences,
+							   NAUTILUS_PREFERENCES_SEARCH_STAY_ON_FILESYSTEM);
+	data->skip_remote_mounts = g_settings_get_boolean (nautilus_preferences,
+							   NAUTILUS_PREFERENCES_SEARCH_SKIP_REMOTE_MOUNTS);
+	data->max_depth = MAX (0, g_settings_get_int (nautilus_preferences,
+						      NAUTILUS_PREFERENCES_SEARCH_MAX_DEPTH));
+	data->mount_time_budget = MAX (0, g_settings_get_int (nautilus_preferences,
+							      NAUTILUS_PREFERENCES_SEARCH_MOUNT_TIME_BUDGET))
+		* G_USEC_PER_SEC;
+	data->mount_entry_budget = MAX (0, g_settings_get_int (nautilus_preferences,
+							       NAUTILUS_PREFERENCES_SEARCH_MOUNT_ENTRY_BUDGET));
+
+	data->ignore_patterns = g_ptr_array_new_with_free_func ((GDestroyNotify) g_pattern_spec_free);
+	patterns = g_settings_get_strv (nautilus_preferences,
+					NAUTILUS_PREFERENCES_SEARCH_IGNORE_PATTERNS);
+	for (i = 0; patterns[i] != NULL; i++) {
+		if (patterns[i][0] != '\0') {
+			g_ptr_array_add (data->ignore_patterns, g_pattern_spec_new (patterns[i]));
+		}
+	}
+	g_strfreev (patterns);
+}
+
 static SearchThreadData *
 search_thread_data_new (NautilusSearchEngineSimple *engine,
 			NautilusQuery *query)
 {
 	SearchThreadData *data;
-	char *text, *lower, *normalized, *uri;
-	GFile *location;
 	
 	data = g_new0 (SearchThreadData, 1);
+	g_mutex_init (&data->lock);
+	g_mutex_init (&data->crawl_lock);
+	g_cond_init (&data->crawl_cond);
 
 	data->engine = engine;
-	data->directories = g_queue_new ();
+	data->roots = g_ptr_array_new_with_free_func ((GDestroyNotify) crawl_root_free);
 	data->visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-	uri = nautilus_query_get_location (query);
-	location = NULL;
-	if (uri != NULL) {
-		location = g_file_new_for_uri (uri);
-		g_free (uri);
-	}
-	if (location == NULL) {
-		location = g_file_new_for_path ("/");
+	data->mounts = g_hash_table_new_full (g_str_hash, g_str_equal,
+					      g_free, (GDestroyNotify) crawl_mount_free);
+	read_crawl_preferences (data);
+
+	/* What the locations are is found out in the thread */
+	data->locations = nautilus_query_get_locations (query);
+	if (data->locations == NULL) {
+		data->locations = g_list_prepend (NULL, g_strdup ("file:///"));
 	}
-	g_queue_push_tail (data->directories, location);
 	
-	text = nautilus_query_get_text (query);
-	normalized = g_utf8_normalize (text, -1, G_NORMALIZE_NFD);
-	lower = g_utf8_strdown (normalized, -1);
-	data->words = g_strsplit (lower, " ", -1);
-	g_free (text);
-	g_free (lower);
-	g_free (normalized);
+	data->filter = search_filter_new (get_query_words (query),
+					  nautilus_query_get_mime_types (query),
+					  0);
+	data->scorer = nautilus_search_hit_scorer_new (query);
 
-	data->mime_types = nautilus_query_get_mime_types (query);
+	if (nautilus_query_get_search_content (query)) {
+		data->content_matcher = get_content_matcher (query);
+	}
+	if (data->content_matcher != NULL) {
+		data->content_pool = g_thread_pool_new (search_content_func, data,
+							get_n_content_threads (),
+							FALSE, NULL);
+	}
 
 	data->cancellable = g_cancellable_new ();
 	
@@ -131,14 +453,21 @@ search_thread_data_new (NautilusSearchEngineSimple *engine,
 static void 
 search_thread_data_free (SearchThreadData *data)
 {
-	g_queue_foreach (data->directories,
-			 (GFunc)g_object_unref, NULL);
-	g_queue_free (data->directories);
+	g_ptr_array_unref (data->roots);
+	g_list_free_full (data->locations, g_free);
+	g_mutex_clear (&data->crawl_lock);
+	g_cond_clear (&data->crawl_cond);
 	g_hash_table_destroy (data->visited);
+	g_hash_table_destroy (data->mounts);
+	g_ptr_array_unref (data->ignore_patterns);
 	g_object_unref (data->cancellable);
-	g_strfreev (data->words);	
-	g_list_free_full (data->mime_types, g_free);
-	g_list_free_full (data->hits, g_object_unref);
+	g_mutex_clear (&data->lock);
+	nautilus_search_hit_scorer_free (data->scorer);
+	if (data->content_matcher != NULL) {
+		nautilus_search_matcher_free (data->content_matcher);
+	}
+	search_filter_unref (data->filter);
+	g_list_free_full (data->hits, (GDestroyNotify) simple_hit_free);
 	g_free (data);
 }
 
@@ -150,6 +479,7 @@ search_thread_done_idle (gpointer user_data)
 	data = user_data;
 
 	if (!g_cancellable_is_cancelled (data->cancellable)) {
+		data->engine->details->incomplete = data->incomplete;
 		nautilus_search_provider_finished (NAUTILUS_SEARCH_PROVIDER (data->engine));
 		data->engine->details->active_search = NULL;
 	}
@@ -169,13 +499,47 @@ static gboolean
 search_thread_add_hits_idle (gpointer user_data)
 {
 	SearchHitsData *data = user_data;
+	SearchThreadData *thread_data;
+	NautilusSearchEngineSimple *engine;
+	SimpleHit *simple_hit;
+	GList *hits, *l;
+
+	thread_data = data->thread_data;
+	engine = thread_data->engine;
+
+	if (!g_cancellable_is_cancelled (thread_data->cancellable)) {
+		hits = NULL;
+		for (l = data->hits; l != NULL; l = l->next) {
+			simple_hit = l->data;
+
+			/* Matched before the query was last refined; the main
+			 * thread is the only one changing the filter, so no
+			 * need to lock here.
+			 */
+			if (simple_hit->generation != thread_data->filter->generation &&
+			    !matches (simple_hit->name, simple_hit->mime_type,
+				      thread_data->filter->words,
+				      thread_data->filter->mime_types)) {
+				simple_hit_free (simple_hit);
+				continue;
+			}
 
-	if (!g_cancellable_is_cancelled (data->thread_data->cancellable)) {
-		nautilus_search_provider_hits_added (NAUTILUS_SEARCH_PROVIDER (data->thread_data->engine),
-						     data->hits);
+			hits = g_list_prepend (hits, simple_hit->hit);
+			g_hash_table_replace (engine->details->hits,
+					      (char *) nautilus_search_hit_get_uri (simple_hit->hit),
+					      simple_hit);
+		}
+
+		if (hits != NULL) {
+			nautilus_search_provider_hits_added (NAUTILUS_SEARCH_PROVIDER (engine), hits);
+			g_list_free (hits);
+		}
+
+		g_list_free (data->hits);
+	} else {
+		g_list_free_full (data->hits, (GDestroyNotify) simple_hit_free);
 	}
 
-	g_list_free_full (data->hits, g_object_unref);
 	g_free (data);
 	
 	return FALSE;
@@ -185,16 +549,215 @@ static void
 send_batch (SearchThreadData *thread_data)
 {
 	SearchHitsData *data;
+	GList *hits;
+
+	g_mutex_lock (&thread_data->lock);
+	hits = thread_data->hits;
+	thread_data->hits = NULL;
+	g_mutex_unlock (&thread_data->lock);
 	
-	thread_data->n_processed_files = 0;
-	
-	if (thread_data->hits) {
+	if (hits) {
 		data = g_new (SearchHitsData, 1);
-		data->hits = thread_data->hits;
+		data->hits = hits;
 		data->thread_data = thread_data;
 		g_idle_add (search_thread_add_hits_idle, data);
 	}
-	thread_data->hits = NULL;
+}
+
+/* Counts a file the crawl or a content reader is done with, and
+ * sends the hits found so far every BATCH_SIZE files. Shared by all
+ * the threads, a batch may come out a little larger or smaller.
+ */
+static void
+count_processed_file (SearchThreadData *data)
+{
+	if (g_atomic_int_add (&data->n_processed_files, 1) >= BATCH_SIZE) {
+		g_atomic_int_set (&data->n_processed_files, 0);
+		send_batch (data);
+	}
+}
+
+/* Takes over @name. @info is the one the crawl enumerated, with
+ * HIT_ATTRIBUTES; the search directory reads the rest for the hits
+ * it shows.
+ */
+static void
+add_hit (SearchThreadData *data,
+	 GFile *file,
+	 GFileInfo *info,
+	 gdouble fts_rank,
+	 char *name,
+	 const char *mime_type,
+	 guint generation)
+{
+	NautilusSearchHit *hit;
+	SimpleHit *simple_hit;
+	GDateTime *dt;
+	GTimeVal mtime;
+	char *uri;
+
+	uri = g_file_get_uri (file);
+	hit = nautilus_search_hit_new (uri);
+	g_free (uri);
+	nautilus_search_hit_set_fts_rank (hit, fts_rank);
+	g_file_info_get_modification_time (info, &mtime);
+	dt = g_date_time_new_from_timeval_local (&mtime);
+	nautilus_search_hit_set_modification_time (hit, dt);
+	g_date_time_unref (dt);
+	nautilus_search_hit_compute_scores_with_scorer (hit, data->scorer);
+
+	/* Good enough to show the file until the full info is read */
+	if (!g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE) &&
+	    g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE)) {
+		g_file_info_set_content_type (info,
+					      g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE));
+	}
+	nautilus_search_hit_set_file_info (hit, info);
+
+	simple_hit = g_slice_new (SimpleHit);
+	simple_hit->hit = hit;
+	simple_hit->name = name;
+	simple_hit->mime_type = g_strdup (mime_type);
+	simple_hit->generation = generation;
+
+	g_mutex_lock (&data->lock);
+	data->hits = g_list_prepend (data->hits, simple_hit);
+	g_mutex_unlock (&data->lock);
+}
+
+static void
+content_job_free (ContentJob *job)
+{
+	g_object_unref (job->file);
+	g_clear_object (&job->info);
+	g_free (job->path);
+	g_free (job->name);
+	g_free (job->mime_type);
+	g_slice_free (ContentJob, job);
+}
+
+/* Reads until @buffer is full or the file ends */
+static gssize
+read_full (int fd, char *buffer, gsize size)
+{
+	gssize n;
+	gsize done;
+
+	done = 0;
+	while (done < size) {
+		n = read (fd, buffer + done, size - done);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n < 0) {
+			return -1;
+		}
+		if (n == 0) {
+			break;
+		}
+		done += n;
+	}
+
+	return done;
+}
+
+/* Runs in the content readers. Every word has to occur in the file;
+ * the more often they do, the higher its full text rank, which stays
+ * below the rank of the files whose names match. The relevance also
+ * counts how recent and how close a file is, so a content match can
+ * still come before an older name match.
+ *
+ * The file is read in chunks rather than mapped, as a file that is
+ * truncated while mapped would bring the whole process down.
+ */
+static void
+search_content_func (gpointer job_data,
+		     gpointer user_data)
+{
+	ContentJob *job;
+	SearchThreadData *data;
+	char *buffer;
+	gsize overlap, kept, total_read;
+	gssize length;
+	guint *counts;
+	guint n_words, n_found, total, i;
+	int fd;
+
+	job = job_data;
+	data = user_data;
+
+	if (g_cancellable_is_cancelled (data->cancellable)) {
+		content_job_free (job);
+		count_processed_file (data);
+		return;
+	}
+
+	fd = open (job->path, O_RDONLY);
+	if (fd < 0) {
+		content_job_free (job);
+		count_processed_file (data);
+		return;
+	}
+
+	n_words = nautilus_search_matcher_get_n_words (data->content_matcher);
+	counts = g_new0 (guint, n_words);
+	overlap = nautilus_search_matcher_get_overlap (data->content_matcher);
+	buffer = g_malloc (overlap + CONTENT_CHUNK_SIZE);
+
+	n_found = 0;
+	kept = 0;
+	total_read = 0;
+	while (total_read < CONTENT_SEARCH_MAX_SIZE &&
+	       !g_cancellable_is_cancelled (data->cancellable)) {
+		length = read_full (fd, buffer + kept, CONTENT_CHUNK_SIZE);
+		if (length <= 0) {
+			break;
+		}
+
+		if (total_read == 0 &&
+		    memchr (buffer, '\0', MIN ((gsize) length, CONTENT_SNIFF_SIZE)) != NULL) {
+			n_found = 0;
+			break;
+		}
+		total_read += length;
+
+		n_found = nautilus_search_matcher_count_chunk (data->content_matcher,
+							       buffer, kept + length,
+							       kept, counts);
+
+		/* Keep the end, for the words that go on in the next chunk */
+		if (kept + length > overlap) {
+			memmove (buffer, buffer + kept + length - overlap, overlap);
+			kept = overlap;
+		} else {
+			kept += length;
+		}
+
+		if (length < CONTENT_CHUNK_SIZE) {
+			break;
+		}
+	}
+
+	close (fd);
+	g_free (buffer);
+
+	if (n_words > 0 && n_found == n_words) {
+		total = 0;
+		for (i = 0; i < n_words; i++) {
+			total += counts[i];
+		}
+
+		add_hit (data, job->file, job->info,
+			 MIN (9.0, 1.0 + log2 (total)),
+			 job->name, job->mime_type, job->generation);
+		job->name = NULL;
+	}
+
+	g_free (counts);
+	content_job_free (job);
+
+	/* The crawl may be over already and no longer sending batches */
+	count_processed_file (data);
 }
 
 #define STD_ATTRIBUTES \
@@ -203,36 +766,230 @@ send_batch (SearchThreadData *thread_data)
 	G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
 	G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
 	G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
-	G_FILE_ATTRIBUTE_ID_FILE
+	G_FILE_ATTRIBUTE_ID_FILE "," \
+	G_FILE_ATTRIBUTE_ID_FILESYSTEM
+
+/* What the hits are shown with at first. All of it comes from the
+ * stat the enumeration does anyway, or from the name.
+ */
+#define HIT_ATTRIBUTES \
+	G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+	G_FILE_ATTRIBUTE_STANDARD_IS_SYMLINK "," \
+	G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+	G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE "," \
+	"time::*,unix::*"
+
+#define CONTENT_ATTRIBUTES \
+	G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE
+
+/* Takes crawl_lock, but not while asking whether the file system is
+ * remote, as that can block for long on a slow or hung mount.
+ */
+static CrawlMount *
+get_mount (SearchThreadData *data,
+	   GFile *dir,
+	   const char *filesystem,
+	   gboolean is_location)
+{
+	CrawlMount *mount, *other;
+	GFileInfo *info;
+
+	if (filesystem == NULL) {
+		filesystem = "";
+	}
+
+	g_mutex_lock (&data->crawl_lock);
+	mount = g_hash_table_lookup (data->mounts, filesystem);
+	g_mutex_unlock (&data->crawl_lock);
+
+	if (mount != NULL) {
+		return mount;
+	}
+
+	mount = g_slice_new0 (CrawlMount);
+
+	/* Whatever the location is on gets searched, it was asked for */
+	if (!is_location && data->stay_on_filesystem) {
+		mount->skip = TRUE;
+	} else if (!is_location && data->skip_remote_mounts) {
+		info = g_file_query_filesystem_info (dir, G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE,
+						     data->cancellable, NULL);
+		if (info != NULL) {
+			mount->skip = g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE);
+			g_object_unref (info);
+		}
+	}
+
+	/* Another thread may have got there first */
+	g_mutex_lock (&data->crawl_lock);
+	other = g_hash_table_lookup (data->mounts, filesystem);
+	if (other != NULL) {
+		g_slice_free (CrawlMount, mount);
+		mount = other;
+	} else {
+		g_hash_table_insert (data->mounts, g_strdup (filesystem), mount);
+	}
+	g_mutex_unlock (&data->crawl_lock);
+
+	return mount;
+}
+
+/* Returns the file system to crawl @child on, or NULL to prune it */
+static CrawlMount *
+get_child_mount (SearchThreadData *data,
+		 CrawlDirectory *parent,
+		 GFile *child,
+		 GFileInfo *info)
+{
+	CrawlMount *mount;
+	const char *filesystem;
+	guint i;
+
+	if (data->max_depth > 0 && parent->depth >= data->max_depth) {
+		return NULL;
+	}
+
+	for (i = 0; i < data->ignore_patterns->len; i++) {
+		if (g_pattern_match_string (g_ptr_array_index (data->ignore_patterns, i),
+					    g_file_info_get_name (info))) {
+			return NULL;
+		}
+	}
+
+	filesystem = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM);
+	if (filesystem == NULL) {
+		return parent->mount;
+	}
+
+	mount = get_mount (data, child, filesystem, FALSE);
+
+	return mount->skip ? NULL : mount;
+}
+
+static gboolean
+mount_budget_exhausted (SearchThreadData *data,
+			guint n_entries,
+			gint64 time_spent)
+{
+	if (data->mount_entry_budget > 0 &&
+	    n_entries > data->mount_entry_budget) {
+		return TRUE;
+	}
+
+	if (data->mount_time_budget > 0 &&
+	    time_spent > data->mount_time_budget) {
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Queues @child to be crawled after @parent, unless it was seen before
+ * or is pruned.
+ */
+static void
+add_child_directory (SearchThreadData *data,
+		     CrawlDirectory *parent,
+		     GFile *child,
+		     GFileInfo *info)
+{
+	CrawlMount *child_mount;
+	const char *id;
+
+	id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
+
+	if (id != NULL) {
+		g_mutex_lock (&data->crawl_lock);
+		if (g_hash_table_lookup_extended (data->visited, id, NULL, NULL)) {
+			g_mutex_unlock (&data->crawl_lock);
+			return;
+		}
+		g_hash_table_insert (data->visited, g_strdup (id), NULL);
+		g_mutex_unlock (&data->crawl_lock);
+	}
+
+	/* Looked up outside of crawl_lock, see get_mount() */
+	child_mount = get_child_mount (data, parent, child, info);
+	if (child_mount == NULL) {
+		return;
+	}
+
+	g_mutex_lock (&data->crawl_lock);
+	g_queue_push_tail (g_ptr_array_index (data->roots, parent->root),
+			   crawl_directory_new (g_object_ref (child),
+						child_mount,
+						parent->depth + 1,
+						parent->root));
+	g_cond_signal (&data->crawl_cond);
+	g_mutex_unlock (&data->crawl_lock);
+}
 
 static void
-visit_directory (GFile *dir, SearchThreadData *data)
+visit_directory (CrawlDirectory *crawl_dir, SearchThreadData *data)
 {
 	GFileEnumerator *enumerator;
 	GFileInfo *info;
-	GFile *child;
+	GFile *dir, *child;
+	CrawlMount *mount;
+	gboolean exhausted;
+	guint mount_entries, n_entries;
+	gint64 mount_time, visit_start;
 	const char *mime_type, *display_name;
 	char *lower_name, *normalized;
-	gboolean found;
-	int i;
-	GList *l;
-	const char *id;
-	gboolean visited;
+	const char *name;
+	gsize name_length;
+	gboolean found, read_content;
+	SearchFilter *filter;
+
+	dir = crawl_dir->dir;
+	mount = crawl_dir->mount;
+
+	/* Other threads may be crawling the same file system, so the
+	 * budget only takes what they did until now into account.
+	 */
+	g_mutex_lock (&data->crawl_lock);
+	exhausted = mount->exhausted;
+	mount_entries = mount->n_entries;
+	mount_time = mount->time_spent;
+	g_mutex_unlock (&data->crawl_lock);
+
+	if (exhausted) {
+		return;
+	}
+	visit_start = g_get_monotonic_time ();
+	n_entries = 0;
+
+	/* A refined query keeps a mime type filter if it had one */
+	filter = get_filter (data);
 
 	enumerator = g_file_enumerate_children (dir,
-						data->mime_types != NULL ?
+						data->content_pool != NULL || filter->mime_types != NULL ?
 						STD_ATTRIBUTES ","
-						G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE
+						HIT_ATTRIBUTES ","
+						CONTENT_ATTRIBUTES
 						:
-						STD_ATTRIBUTES
+						STD_ATTRIBUTES ","
+						HIT_ATTRIBUTES
 						,
 						0, data->cancellable, NULL);
 	
 	if (enumerator == NULL) {
+		search_filter_unref (filter);
 		return;
 	}
 
 	while ((info = g_file_enumerator_next_file (enumerator, data->cancellable, NULL)) != NULL) {
+		n_entries++;
+		if (mount_budget_exhausted (data, mount_entries + n_entries,
+					    mount_time + g_get_monotonic_time () - visit_start)) {
+			g_mutex_lock (&data->crawl_lock);
+			mount->exhausted = TRUE;
+			data->incomplete = TRUE;
+			g_mutex_unlock (&data->crawl_lock);
+			g_object_unref (info);
+			break;
+		}
+
 		if (g_file_info_get_is_hidden (info)) {
 			goto next;
 		}
@@ -242,71 +999,75 @@ visit_directory (GFile *dir, SearchThreadData *data)
 			goto next;
 		}
 		
-		normalized = g_utf8_normalize (display_name, -1, G_NORMALIZE_NFD);
-		lower_name = g_utf8_strdown (normalized, -1);
-		g_free (normalized);
-		
-		found = TRUE;
-		for (i = 0; data->words[i] != NULL; i++) {
-			if (strstr (lower_name, data->words[i]) == NULL) {
-				found = FALSE;
-				break;
-			}
+		/* NFD and lowercasing leave ASCII names alone but for the
+		 * case of letters, which the matcher ignores anyway, so
+		 * only the others need to be converted.
+		 */
+		name_length = strlen (display_name);
+		if (nautilus_search_matcher_is_ascii (display_name, name_length)) {
+			name = display_name;
+			lower_name = NULL;
+		} else {
+			normalized = g_utf8_normalize (display_name, name_length, G_NORMALIZE_NFD);
+			lower_name = g_utf8_strdown (normalized, -1);
+			g_free (normalized);
+
+			name = lower_name;
+			name_length = strlen (lower_name);
 		}
-		g_free (lower_name);
-		
-		if (found && data->mime_types) {
+
+		mime_type = NULL;
+		if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE)) {
 			mime_type = g_file_info_get_content_type (info);
-			found = FALSE;
-			
-			for (l = data->mime_types; mime_type != NULL && l != NULL; l = l->next) {
-				if (g_content_type_equals (mime_type, l->data)) {
-					found = TRUE;
-					break;
-				}
-			}
 		}
+
+		if ((guint) g_atomic_int_get (&data->generation) != filter->generation) {
+			search_filter_unref (filter);
+			filter = get_filter (data);
+		}
+
+		found = nautilus_search_matcher_match_all (filter->name_matcher, name, name_length) &&
+			matches_mime_type (mime_type, filter->mime_types);
+		read_content = !found &&
+			data->content_pool != NULL &&
+			g_file_info_get_file_type (info) == G_FILE_TYPE_REGULAR &&
+			g_file_info_get_size (info) <= CONTENT_SEARCH_MAX_SIZE &&
+			matches_mime_type (mime_type, filter->mime_types);
 		
+		if ((found || read_content) && lower_name == NULL) {
+			lower_name = g_ascii_strdown (display_name, name_length);
+		}
+
 		child = g_file_get_child (dir, g_file_info_get_name (info));
 		
 		if (found) {
-			NautilusSearchHit *hit;
-			GTimeVal tv;
-			GDateTime *dt;
-			char *uri;
-
-			uri = g_file_get_uri (child);
-			hit = nautilus_search_hit_new (uri);
-			g_free (uri);
-			nautilus_search_hit_set_fts_rank (hit, 10.0);
-			g_file_info_get_modification_time (info, &tv);
-			dt = g_date_time_new_from_timeval_local (&tv);
-			nautilus_search_hit_set_modification_time (hit, dt);
-			g_date_time_unref (dt);
-
-			data->hits = g_list_prepend (data->hits, hit);
-		}
-		
-		data->n_processed_files++;
-		if (data->n_processed_files > BATCH_SIZE) {
-			send_batch (data);
+			add_hit (data, child, info, 10.0, lower_name, mime_type, filter->generation);
+			lower_name = NULL;
+		} else if (read_content) {
+			ContentJob *job;
+
+			job = g_slice_new (ContentJob);
+			job->path = g_file_get_path (child);
+			if (job->path != NULL) {
+				job->file = g_object_ref (child);
+				job->name = lower_name;
+				job->mime_type = g_strdup (mime_type);
+				job->info = g_object_ref (info);
+				job->generation = filter->generation;
+				lower_name = NULL;
+
+				g_thread_pool_push (data->content_pool, job, NULL);
+			} else {
+				g_slice_free (ContentJob, job);
+			}
 		}
 
+		g_free (lower_name);
+
+		count_processed_file (data);
+
 		if (data->engine->details->recursive && g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
-			id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
-			visited = FALSE;
-			if (id) {
-				if (g_hash_table_lookup_extended (data->visited,
-								  id, NULL, NULL)) {
-					visited = TRUE;
-				} else {
-					g_hash_table_insert (data->visited, g_strdup (id), NULL);
-				}
-			}
-			
-			if (!visited) {
-				g_queue_push_tail (data->directories, g_object_ref (child));
-			}
+			add_child_directory (data, crawl_dir, child, info);
 		}
 		
 		g_object_unref (child);
@@ -315,6 +1076,123 @@ visit_directory (GFile *dir, SearchThreadData *data)
 	}
 
 	g_object_unref (enumerator);
+	search_filter_unref (filter);
+
+	g_mutex_lock (&data->crawl_lock);
+	mount->n_entries += n_entries;
+	mount->time_spent += g_get_monotonic_time () - visit_start;
+	g_mutex_unlock (&data->crawl_lock);
+}
+
+/* Takes the next directory from each location in turn, so that a large
+ * one does not hold up the others. Returns NULL once all the locations
+ * are crawled, or the search is cancelled.
+ */
+static CrawlDirectory *
+next_directory (SearchThreadData *data)
+{
+	CrawlDirectory *crawl_dir;
+	guint i, root;
+
+	g_mutex_lock (&data->crawl_lock);
+
+	for (;;) {
+		if (g_cancellable_is_cancelled (data->cancellable)) {
+			break;
+		}
+
+		for (i = 0; i < data->roots->len; i++) {
+			root = (data->next_root + i) % data->roots->len;
+			crawl_dir = g_queue_pop_head (g_ptr_array_index (data->roots, root));
+			if (crawl_dir != NULL) {
+				data->next_root = root + 1;
+				data->n_busy++;
+				g_mutex_unlock (&data->crawl_lock);
+
+				return crawl_dir;
+			}
+		}
+
+		/* Nothing queued, and nobody who could queue more */
+		if (data->n_busy == 0) {
+			break;
+		}
+
+		g_cond_wait (&data->crawl_cond, &data->crawl_lock);
+	}
+
+	g_cond_broadcast (&data->crawl_cond);
+	g_mutex_unlock (&data->crawl_lock);
+
+	return NULL;
+}
+
+static gpointer
+crawl_thread_func (gpointer user_data)
+{
+	SearchThreadData *data;
+	CrawlDirectory *crawl_dir;
+
+	data = user_data;
+
+	while ((crawl_dir = next_directory (data)) != NULL) {
+		visit_directory (crawl_dir, data);
+		crawl_directory_free (crawl_dir);
+
+		g_mutex_lock (&data->crawl_lock);
+		data->n_busy--;
+		if (data->n_busy == 0) {
+			g_cond_broadcast (&data->crawl_cond);
+		}
+		g_mutex_unlock (&data->crawl_lock);
+	}
+
+	return NULL;
+}
+
+/* Every location gets a queue of its own, unless it is the same as
+ * one before it. One inside another is only crawled once too, as its
+ * id is already in visited when the crawl of the outer one gets there.
+ */
+static void
+add_roots (SearchThreadData *data)
+{
+	GQueue *root;
+	GFile *location;
+	GFileInfo *info;
+	CrawlMount *mount;
+	const char *id, *filesystem;
+	GList *l;
+
+	for (l = data->locations; l != NULL; l = l->next) {
+		location = g_file_new_for_uri (l->data);
+
+		filesystem = NULL;
+		info = g_file_query_info (location,
+					  G_FILE_ATTRIBUTE_ID_FILE ","
+					  G_FILE_ATTRIBUTE_ID_FILESYSTEM,
+					  0, data->cancellable, NULL);
+		if (info) {
+			id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
+			if (id) {
+				if (g_hash_table_lookup_extended (data->visited, id, NULL, NULL)) {
+					g_object_unref (info);
+					g_object_unref (location);
+					continue;
+				}
+				g_hash_table_insert (data->visited, g_strdup (id), NULL);
+			}
+			filesystem = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM);
+		}
+		mount = get_mount (data, location, filesystem, TRUE);
+		if (info) {
+			g_object_unref (info);
+		}
+
+		root = g_queue_new ();
+		g_queue_push_tail (root, crawl_directory_new (location, mount, 0, data->roots->len));
+		g_ptr_array_add (data->roots, root);
+	}
 }
 
 
@@ -322,28 +1200,31 @@ static gpointer
 search_thread_func (gpointer user_data)
 {
 	SearchThreadData *data;
-	GFile *dir;
-	GFileInfo *info;
-	const char *id;
+	GThread **threads;
+	guint n_threads, i;
 
 	data = user_data;
 
-	/* Insert id for toplevel directory into visited */
-	dir = g_queue_peek_head (data->directories);
-	info = g_file_query_info (dir, G_FILE_ATTRIBUTE_ID_FILE, 0, data->cancellable, NULL);
-	if (info) {
-		id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
-		if (id) {
-			g_hash_table_insert (data->visited, g_strdup (id), NULL);
-		}
-		g_object_unref (info);
+	add_roots (data);
+
+	/* This thread crawls too */
+	n_threads = CLAMP (data->roots->len, 1, CRAWL_MAX_THREADS);
+	threads = g_new0 (GThread *, n_threads);
+	for (i = 1; i < n_threads; i++) {
+		threads[i] = g_thread_new ("nautilus-search-crawl", crawl_thread_func, data);
 	}
-	
-	while (!g_cancellable_is_cancelled (data->cancellable) &&
-	       (dir = g_queue_pop_head (data->directories)) != NULL) {
-		visit_directory (dir, data);
-		g_object_unref (dir);
+	crawl_thread_func (data);
+	for (i = 1; i < n_threads; i++) {
+		g_thread_join (threads[i]);
+	}
+	g_free (threads);
+
+	/* Readers give up on the files left once the search is cancelled */
+	if (data->content_pool != NULL) {
+		g_thread_pool_free (data->content_pool, FALSE, TRUE);
+		data->content_pool = NULL;
 	}
+
 	send_batch (data);
 
 	g_idle_add (search_thread_done_idle, data);
@@ -370,6 +1251,13 @@ nautilus_search_engine_simple_start (NautilusSearchProvider *provider)
 	
 	data = search_thread_data_new (simple, simple->details->query);
 
+	if (simple->details->hits != NULL) {
+		g_hash_table_destroy (simple->details->hits);
+	}
+	simple->details->hits = g_hash_table_new_full (g_str_hash, g_str_equal,
+						       NULL, (GDestroyNotify) simple_hit_free);
+	simple->details->incomplete = FALSE;
+
 	thread = g_thread_new ("nautilus-search-simple", search_thread_func, data);
 	simple->details->active_search = data;
 
@@ -387,6 +1275,86 @@ nautilus_search_engine_simple_stop (NautilusSearchProvider *provider)
 		g_cancellable_cancel (simple->details->active_search->cancellable);
 		simple->details->active_search = NULL;
 	}
+
+	if (simple->details->hits != NULL) {
+		g_hash_table_destroy (simple->details->hits);
+		simple->details->hits = NULL;
+	}
+}
+
+/* Only the results of a search that was started and not stopped
+ * can be narrowed down; they stay valid once it finished.
+ */
+static gboolean
+nautilus_search_engine_simple_can_refine_query (NautilusSearchProvider *provider,
+						NautilusQuery          *query)
+{
+	NautilusSearchEngineSimple *simple;
+
+	simple = NAUTILUS_SEARCH_ENGINE_SIMPLE (provider);
+
+	return simple->details->hits != NULL;
+}
+
+static gboolean
+nautilus_search_engine_simple_refine_query (NautilusSearchProvider *provider,
+					    NautilusQuery          *query)
+{
+	NautilusSearchEngineSimple *simple;
+	SearchThreadData *data;
+	GHashTableIter iter;
+	SimpleHit *simple_hit;
+	GList *mime_types, *subtracted;
+	char **words;
+	SearchFilter *filter, *old_filter;
+
+	simple = NAUTILUS_SEARCH_ENGINE_SIMPLE (provider);
+
+	if (!nautilus_search_engine_simple_can_refine_query (provider, query)) {
+		return FALSE;
+	}
+
+	words = get_query_words (query);
+	mime_types = nautilus_query_get_mime_types (query);
+
+	subtracted = NULL;
+	g_hash_table_iter_init (&iter, simple->details->hits);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &simple_hit)) {
+		if (!matches (simple_hit->name, simple_hit->mime_type, words, mime_types)) {
+			subtracted = g_list_prepend (subtracted, g_object_ref (simple_hit->hit));
+			g_hash_table_iter_remove (&iter);
+		}
+	}
+
+	nautilus_search_engine_simple_set_query (provider, query);
+
+	/* Let the crawl go on with the narrower query; the batches it
+	 * already matched with the old one are checked again when they
+	 * arrive.
+	 */
+	data = simple->details->active_search;
+	if (data != NULL) {
+		filter = search_filter_new (words, mime_types,
+					    data->filter->generation + 1);
+
+		g_mutex_lock (&data->lock);
+		old_filter = data->filter;
+		data->filter = filter;
+		g_atomic_int_set (&data->generation, filter->generation);
+		g_mutex_unlock (&data->lock);
+
+		search_filter_unref (old_filter);
+	} else {
+		g_strfreev (words);
+		g_list_free_full (mime_types, g_free);
+	}
+
+	if (subtracted != NULL) {
+		nautilus_search_provider_hits_subtracted (provider, subtracted);
+		g_list_free_full (subtracted, g_object_unref);
+	}
+
+	return TRUE;
 }
 
 static void
@@ -451,6 +1419,8 @@ nautilus_search_provider_init (NautilusSearchProviderIface *iface)
 	iface->set_query = nautilus_search_engine_simple_set_query;
 	iface->start = nautilus_search_engine_simple_start;
 	iface->stop = nautilus_search_engine_simple_stop;
+	iface->refine_query = nautilus_search_engine_simple_refine_query;
+	iface->can_refine_query = nautilus_search_engine_simple_can_refine_query;
 }
 
 static void
@@ -480,6 +1450,12 @@ nautilus_search_engine_simple_init (NautilusSearchEngineSimple *engine)
 						       NautilusSearchEngineSimpleDetails);
 }
 
+gboolean
+nautilus_search_engine_simple_is_incomplete (NautilusSearchEngineSimple *engine)
+{
+	return engine->details->incomplete;
+}
+
 NautilusSearchEngineSimple *
 nautilus_search_engine_simple_new (void)
 {
@@ -48,4 +48,9 @@ GType          nautilus_search_engine_simple_get_type  (void);
 
 NautilusSearchEngineSimple* nautilus_search_engine_simple_new       (void);
 
+/* Whether the last search that finished gave up on some file systems
+ * because their crawl budget ran out.
+ */
+gboolean       nautilus_search_engine_simple_is_incomplete (NautilusSearchEngineSimple *engine);
+
 #endif /* NAUTILUS_SEARCH_ENGINE_SIMPLE_H */
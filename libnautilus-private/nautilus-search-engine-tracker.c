@@ -36,6 +36,8 @@ struct NautilusSearchEngineTrackerDetails {
 
 	gboolean       query_pending;
 	GCancellable  *cancellable;
+
+	NautilusSearchHitScorer *scorer;
 };
 
 static void nautilus_search_provider_init (NautilusSearchProviderIface  *iface);
@@ -60,6 +62,9 @@ finalize (GObject *object)
 
 	g_clear_object (&tracker->details->query);
 	g_clear_object (&tracker->details->connection);
+	if (tracker->details->scorer != NULL) {
+		nautilus_search_hit_scorer_free (tracker->details->scorer);
+	}
 
 	G_OBJECT_CLASS (nautilus_search_engine_tracker_parent_class)->finalize (object);
 }
@@ -138,6 +143,7 @@ cursor_callback (GObject      *object,
 	} else {
 		g_warning ("unable to parse atime: %s", atime_str);
 	}
+	nautilus_search_hit_compute_scores_with_scorer (hit, tracker->details->scorer);
 
 	hits = g_list_append (NULL, hit);
 	nautilus_search_provider_hits_added (NAUTILUS_SEARCH_PROVIDER (tracker), hits);
@@ -184,9 +190,9 @@ static void
 nautilus_search_engine_tracker_start (NautilusSearchProvider *provider)
 {
 	NautilusSearchEngineTracker *tracker;
-	gchar	*query_text, *search_text, *location_uri, *downcase;
+	gchar	*query_text, *search_text, *downcase;
 	GString *sparql;
-	GList *mimetypes, *l;
+	GList *locations, *mimetypes, *l;
 	gint mime_count;
 
 	tracker = NAUTILUS_SEARCH_ENGINE_TRACKER (provider);
@@ -199,13 +205,18 @@ nautilus_search_engine_tracker_start (NautilusSearchProvider *provider)
 		return;
 	}
 
+	if (tracker->details->scorer != NULL) {
+		nautilus_search_hit_scorer_free (tracker->details->scorer);
+	}
+	tracker->details->scorer = nautilus_search_hit_scorer_new (tracker->details->query);
+
 	query_text = nautilus_query_get_text (tracker->details->query);
 	downcase = g_utf8_strdown (query_text, -1);
 	search_text = tracker_sparql_escape_string (downcase);
 	g_free (query_text);
 	g_free (downcase);
 
-	location_uri = nautilus_query_get_location (tracker->details->query);
+	locations = nautilus_query_get_locations (tracker->details->query);
 	mimetypes = nautilus_query_get_mime_types (tracker->details->query);
 
 	mime_count = g_list_length (mimetypes);
@@ -222,9 +233,20 @@ nautilus_search_engine_tracker_start (NautilusSearchProvider *provider)
 	g_string_append_printf (sparql, " fts:match '%s*'", search_text);
 	g_string_append (sparql, " . FILTER (");
 	
-	if (location_uri)  {
-		g_string_append_printf (sparql, " fn:starts-with(nie:url(?urn), '%s')",
-					location_uri);
+	if (locations != NULL) {
+		g_string_append (sparql, " (");
+
+		for (l = locations; l != NULL; l = l->next) {
+			if (l != locations) {
+				g_string_append (sparql, " || ");
+			}
+
+			g_string_append_printf (sparql, "fn:starts-with(nie:url(?urn), '%s')",
+						(gchar *) l->data);
+		}
+		g_string_append (sparql, ")");
+	} else {
+		g_string_append (sparql, " true");
 	}
 
 	g_string_append_printf (sparql, " && fn:contains(fn:lower-case(nfo:fileName(?urn)), '%s')",
@@ -256,7 +278,7 @@ nautilus_search_engine_tracker_start (NautilusSearchProvider *provider)
 	g_string_free (sparql, TRUE);
 
 	g_free (search_text);
-	g_free (location_uri);
+	g_list_free_full (locations, g_free);
 	g_list_free_full (mimetypes, g_free);
 }
 
@@ -299,6 +321,11 @@ nautilus_search_provider_init (NautilusSearchProviderIface *iface)
 	iface->set_query = nautilus_search_engine_tracker_set_query;
 	iface->start = nautilus_search_engine_tracker_start;
 	iface->stop = nautilus_search_engine_tracker_stop;
+	/* No refine_query: fts:match also finds words in the contents and
+	 * its prefix matching differs from the file name filter, so what a
+	 * narrower query finds can't be told from the hits here. A new
+	 * query is run instead.
+	 */
 }
 
 static void
@@ -71,6 +71,7 @@ nautilus_search_engine_start (NautilusSearchProvider *provider)
 	NautilusSearchEngine *engine = NAUTILUS_SEARCH_ENGINE (provider);
 	engine->details->providers_finished = 0;
 	engine->details->providers_error = 0;
+	g_hash_table_remove_all (engine->details->uris);
 #ifdef ENABLE_TRACKER
 	nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (engine->details->tracker));
 #endif
@@ -87,6 +88,42 @@ nautilus_search_engine_stop (NautilusSearchProvider *provider)
 	nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (engine->details->simple));
 }
 
+static gboolean
+nautilus_search_engine_can_refine_query (NautilusSearchProvider *provider,
+					 NautilusQuery          *query)
+{
+	NautilusSearchEngine *engine = NAUTILUS_SEARCH_ENGINE (provider);
+#ifdef ENABLE_TRACKER
+	if (engine->details->tracker != NULL &&
+	    !nautilus_search_provider_can_refine_query (NAUTILUS_SEARCH_PROVIDER (engine->details->tracker), query)) {
+		return FALSE;
+	}
+#endif
+	return nautilus_search_provider_can_refine_query (NAUTILUS_SEARCH_PROVIDER (engine->details->simple), query);
+}
+
+/* Every provider is asked first, so that none is refined unless all
+ * of them can be.
+ */
+static gboolean
+nautilus_search_engine_refine_query (NautilusSearchProvider *provider,
+				     NautilusQuery          *query)
+{
+	NautilusSearchEngine *engine = NAUTILUS_SEARCH_ENGINE (provider);
+
+	if (!nautilus_search_engine_can_refine_query (provider, query)) {
+		return FALSE;
+	}
+#ifdef ENABLE_TRACKER
+	if (engine->details->tracker != NULL) {
+		nautilus_search_provider_refine_query (NAUTILUS_SEARCH_PROVIDER (engine->details->tracker), query);
+	}
+#endif
+	nautilus_search_provider_refine_query (NAUTILUS_SEARCH_PROVIDER (engine->details->simple), query);
+
+	return TRUE;
+}
+
 static void
 search_provider_hits_added (NautilusSearchProvider *provider,
 			    GList                  *hits,
@@ -104,7 +141,7 @@ search_provider_hits_added (NautilusSearchProvider *provider,
 		count = GPOINTER_TO_INT (g_hash_table_lookup (engine->details->uris, uri));
 		if (count == 0)
 			added = g_list_prepend (added, hit);
-		g_hash_table_replace (engine->details->uris, g_strdup (uri), GINT_TO_POINTER (count++));
+		g_hash_table_replace (engine->details->uris, g_strdup (uri), GINT_TO_POINTER (++count));
 	}
 	if (added != NULL) {
 		added = g_list_reverse (added);
@@ -133,11 +170,12 @@ search_provider_hits_subtracted (NautilusSearchProvider *provider,
 			removed = g_list_prepend (removed, hit);
 			g_hash_table_remove (engine->details->uris, uri);
 		} else {
-			g_hash_table_replace (engine->details->uris, g_strdup (uri), GINT_TO_POINTER (count--));
+			g_hash_table_replace (engine->details->uris, g_strdup (uri), GINT_TO_POINTER (--count));
 		}
 	}
 	if (removed != NULL) {
-		nautilus_search_provider_hits_subtracted (NAUTILUS_SEARCH_PROVIDER (engine), g_list_reverse (removed));
+		removed = g_list_reverse (removed);
+		nautilus_search_provider_hits_subtracted (NAUTILUS_SEARCH_PROVIDER (engine), removed);
 		g_list_free (removed);
 	}
 }
@@ -190,6 +228,8 @@ nautilus_search_provider_init (NautilusSearchProviderIface *iface)
 	iface->set_query = nautilus_search_engine_set_query;
 	iface->start = nautilus_search_engine_start;
 	iface->stop = nautilus_search_engine_stop;
+	iface->refine_query = nautilus_search_engine_refine_query;
+	iface->can_refine_query = nautilus_search_engine_can_refine_query;
 }
 
 static void
@@ -239,6 +279,13 @@ nautilus_search_engine_init (NautilusSearchEngine *engine)
 	engine->details->num_providers++;
 }
 
+/* Only the simple engine crawls, and might not get everywhere */
+gboolean
+nautilus_search_engine_is_incomplete (NautilusSearchEngine *engine)
+{
+	return nautilus_search_engine_simple_is_incomplete (engine->details->simple);
+}
+
 NautilusSearchEngine *
 nautilus_search_engine_new (void)
 {
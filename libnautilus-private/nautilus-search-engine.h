@@ -48,4 +48,6 @@ GType          nautilus_search_engine_get_type  (void);
 
 NautilusSearchEngine* nautilus_search_engine_new       (void);
 
+gboolean       nautilus_search_engine_is_incomplete (NautilusSearchEngine *engine);
+
 #endif /* NAUTILUS_SEARCH_ENGINE_H */
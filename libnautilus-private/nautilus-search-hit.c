@@ -35,6 +35,8 @@ struct NautilusSearchHitDetails
 	gdouble    fts_rank;
 
 	gdouble    relevance;
+
+	GFileInfo *file_info;
 };
 
 enum {
@@ -48,39 +50,136 @@ enum {
 
 G_DEFINE_TYPE (NautilusSearchHit, nautilus_search_hit, G_TYPE_OBJECT)
 
+/* What the scores need from the query, worked out once */
+struct NautilusSearchHitScorer
+{
+	char      *query_path;
+	gsize      query_path_len;
+
+	/* All the locations of the query, the main one first */
+	char     **root_uris;
+	gsize     *root_uri_lens;
+
+	GDateTime *now;
+};
+
+NautilusSearchHitScorer *
+nautilus_search_hit_scorer_new (NautilusQuery *query)
+{
+	NautilusSearchHitScorer *scorer;
+	GList *locations, *l;
+	guint i;
+
+	scorer = g_slice_new0 (NautilusSearchHitScorer);
+
+	locations = nautilus_query_get_locations (query);
+	scorer->root_uris = g_new0 (char *, g_list_length (locations) + 1);
+	scorer->root_uri_lens = g_new0 (gsize, g_list_length (locations) + 1);
+	for (l = locations, i = 0; l != NULL; l = l->next, i++) {
+		scorer->root_uris[i] = l->data;
+		scorer->root_uri_lens[i] = strlen (l->data);
+	}
+	g_list_free (locations);
+
+	if (scorer->root_uris[0] != NULL) {
+		scorer->query_path = g_filename_from_uri (scorer->root_uris[0], NULL, NULL);
+	}
+	if (scorer->query_path != NULL) {
+		scorer->query_path_len = strlen (scorer->query_path);
+	}
+
+	scorer->now = g_date_time_new_now_local ();
+
+	return scorer;
+}
+
+void
+nautilus_search_hit_scorer_free (NautilusSearchHitScorer *scorer)
+{
+	g_free (scorer->query_path);
+	g_strfreev (scorer->root_uris);
+	g_free (scorer->root_uri_lens);
+	g_date_time_unref (scorer->now);
+	g_slice_free (NautilusSearchHitScorer, scorer);
+}
+
+/* Number of directories between the query location the hit is in,
+ * or else the main one, and the parent of the hit.
+ */
+static guint
+get_dir_count (NautilusSearchHitScorer *scorer,
+	       const char *uri)
+{
+	const char *p;
+	char *hit_path;
+	char *hit_parent;
+	guint dir_count, r;
+	gsize i;
+
+	/* Hits below a query location have its uri as a prefix, and
+	 * a '/' in the rest is a directory separator, so there is no
+	 * need to convert them to paths.
+	 */
+	for (r = 0; scorer->root_uris[r] != NULL; r++) {
+		if (strncmp (uri, scorer->root_uris[r], scorer->root_uri_lens[r]) != 0) {
+			continue;
+		}
+
+		dir_count = 0;
+		for (p = uri + scorer->root_uri_lens[r]; *p != '\0'; p++) {
+			if (*p == '/')
+				dir_count++;
+		}
+		if (dir_count > 0) {
+			/* The one before the basename */
+			dir_count--;
+		}
+
+		return dir_count;
+	}
+
+	hit_path = g_filename_from_uri (uri, NULL, NULL);
+	if (hit_path == NULL) {
+		return 0;
+	}
+	hit_parent = g_path_get_dirname (hit_path);
+	g_free (hit_path);
+
+	dir_count = 0;
+	for (i = MIN (scorer->query_path_len, strlen (hit_parent)); hit_parent[i] != '\0'; i++) {
+		if (G_IS_DIR_SEPARATOR (hit_parent[i]))
+			dir_count++;
+	}
+	g_free (hit_parent);
+
+	return dir_count;
+}
+
 void
 nautilus_search_hit_compute_scores (NautilusSearchHit *hit,
 				    NautilusQuery     *query)
 {
-	GDateTime *now;
-	char *query_uri;
-	char *query_path;
-	int i;
+	NautilusSearchHitScorer *scorer;
+
+	scorer = nautilus_search_hit_scorer_new (query);
+	nautilus_search_hit_compute_scores_with_scorer (hit, scorer);
+	nautilus_search_hit_scorer_free (scorer);
+}
+
+void
+nautilus_search_hit_compute_scores_with_scorer (NautilusSearchHit       *hit,
+						NautilusSearchHitScorer *scorer)
+{
 	GTimeSpan m_diff = G_MAXINT64;
 	GTimeSpan a_diff = G_MAXINT64;
 	GTimeSpan t_diff = G_MAXINT64;
 	gdouble recent_bonus = 0.0;
 	gdouble proximity_bonus = 0.0;
 	gdouble match_bonus = 0.0;
+	guint dir_count;
 
-	query_uri = nautilus_query_get_location (query);
-	query_path = g_filename_from_uri (query_uri, NULL, NULL);
-	g_free (query_uri);
-	if (query_path != NULL) {
-		char *hit_path;
-		char *hit_parent;
-		guint dir_count;
-
-		hit_path = g_filename_from_uri (hit->details->uri, NULL, NULL);
-		hit_parent = g_path_get_dirname (hit_path);
-		g_free (hit_path);
-
-		dir_count = 0;
-		for (i = strlen (query_path); hit_parent[i] != '\0'; i++) {
-			if (G_IS_DIR_SEPARATOR (hit_parent[i]))
-				dir_count++;
-		}
-		g_free (hit_parent);
+	if (scorer->query_path != NULL) {
+		dir_count = get_dir_count (scorer, hit->details->uri);
 
 		if (dir_count < 10) {
 			proximity_bonus = 100.0 - 10 * dir_count;
@@ -88,13 +187,11 @@ nautilus_search_hit_compute_scores (NautilusSearchHit *hit,
 			proximity_bonus = 0.0;
 		}
 	}
-	g_free (query_path);
 
-	now = g_date_time_new_now_local ();
 	if (hit->details->modification_time != NULL)
-		m_diff = g_date_time_difference (now, hit->details->modification_time);
+		m_diff = g_date_time_difference (scorer->now, hit->details->modification_time);
 	if (hit->details->access_time != NULL)
-		a_diff = g_date_time_difference (now, hit->details->access_time);
+		a_diff = g_date_time_difference (scorer->now, hit->details->access_time);
 	m_diff /= G_TIME_SPAN_DAY;
 	a_diff /= G_TIME_SPAN_DAY;
 	t_diff = MIN (m_diff, a_diff);
@@ -119,8 +216,6 @@ nautilus_search_hit_compute_scores (NautilusSearchHit *hit,
 	}
 
 	hit->details->relevance = recent_bonus + proximity_bonus + match_bonus;
-
-	g_date_time_unref (now);
 }
 
 const char *
@@ -174,6 +269,24 @@ nautilus_search_hit_set_access_time (NautilusSearchHit *hit,
 		hit->details->access_time = NULL;
 }
 
+/* The info is the one the search found the file with, so that it
+ * does not have to be read again when the file is shown.
+ */
+void
+nautilus_search_hit_set_file_info (NautilusSearchHit *hit,
+				   GFileInfo         *info)
+{
+	g_clear_object (&hit->details->file_info);
+	if (info != NULL)
+		hit->details->file_info = g_object_ref (info);
+}
+
+GFileInfo *
+nautilus_search_hit_get_file_info (NautilusSearchHit *hit)
+{
+	return hit->details->file_info;
+}
+
 static void
 nautilus_search_hit_set_property (GObject *object,
 				  guint arg_id,
@@ -187,6 +300,7 @@ nautilus_search_hit_set_property (GObject *object,
 	switch (arg_id) {
 	case PROP_RELEVANCE:
 		hit->details->relevance = g_value_get_double (value);
+		break;
 	case PROP_FTS_RANK:
 		nautilus_search_hit_set_fts_rank (hit, g_value_get_double (value));
 		break;
@@ -250,6 +364,7 @@ nautilus_search_hit_finalize (GObject *object)
 	if (hit->details->modification_time != NULL) {
 		g_date_time_unref (hit->details->modification_time);
 	}
+	g_clear_object (&hit->details->file_info);
 
 	G_OBJECT_CLASS (nautilus_search_hit_parent_class)->finalize (object);
 }
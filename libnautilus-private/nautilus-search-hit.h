@@ -23,6 +23,7 @@
 #define NAUTILUS_SEARCH_HIT_H
 
 #include <glib-object.h>
+#include <gio/gio.h>
 #include "nautilus-query.h"
 
 #define NAUTILUS_TYPE_SEARCH_HIT		(nautilus_search_hit_get_type ())
@@ -33,6 +34,7 @@
 #define NAUTILUS_SEARCH_HIT_GET_CLASS(obj)    (G_TYPE_INSTANCE_GET_CLASS ((obj), NAUTILUS_TYPE_SEARCH_HIT, NautilusSearchHitClass))
 
 typedef struct NautilusSearchHitDetails NautilusSearchHitDetails;
+typedef struct NautilusSearchHitScorer NautilusSearchHitScorer;
 
 typedef struct NautilusSearchHit {
 	GObject parent;
@@ -53,11 +55,23 @@ void                nautilus_search_hit_set_modification_time (NautilusSearchHit
 							       GDateTime         *date);
 void                nautilus_search_hit_set_access_time       (NautilusSearchHit *hit,
 							       GDateTime         *date);
+void                nautilus_search_hit_set_file_info         (NautilusSearchHit *hit,
+							       GFileInfo         *info);
 
 void                nautilus_search_hit_compute_scores        (NautilusSearchHit *hit,
 							       NautilusQuery     *query);
 
+/* Scores many hits for the same query. A scorer does not change once
+ * created, so it can be shared by search threads.
+ */
+NautilusSearchHitScorer *
+                    nautilus_search_hit_scorer_new            (NautilusQuery     *query);
+void                nautilus_search_hit_scorer_free           (NautilusSearchHitScorer *scorer);
+void                nautilus_search_hit_compute_scores_with_scorer (NautilusSearchHit       *hit,
+								    NautilusSearchHitScorer *scorer);
+
 const char *        nautilus_search_hit_get_uri               (NautilusSearchHit *hit);
 gdouble             nautilus_search_hit_get_relevance         (NautilusSearchHit *hit);
+GFileInfo *         nautilus_search_hit_get_file_info         (NautilusSearchHit *hit);
 
 #endif /* NAUTILUS_SEARCH_HIT_H */
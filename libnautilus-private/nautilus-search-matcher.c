@@ -0,0 +1,271 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-search-matcher.c: Finding several words in a buffer at once.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+/* The words are looked for in a single pass, Horspool style: a window
+ * as long as the shortest word slides over the text, and the last byte
+ * under it tells how far it can move on without passing over the start
+ * of any word. On text most bytes of which appear in none of the words,
+ * the window moves by nearly its whole length each time.
+ */
+
+#include <config.h>
+#include "nautilus-search-matcher.h"
+
+#include <string.h>
+
+struct NautilusSearchMatcher {
+	guint n_words;
+	guchar **words;
+	gsize *lengths;
+	gsize window;
+	gsize longest;
+
+	gsize shift[256];
+};
+
+static guchar fold[256];
+
+static void
+init_fold (void)
+{
+	static gsize initialized = 0;
+	int c;
+
+	if (g_once_init_enter (&initialized)) {
+		for (c = 0; c < 256; c++) {
+			fold[c] = g_ascii_tolower (c);
+		}
+		g_once_init_leave (&initialized, 1);
+	}
+}
+
+NautilusSearchMatcher *
+nautilus_search_matcher_new (char **words)
+{
+	NautilusSearchMatcher *matcher;
+	gsize length, i;
+	guint n, w;
+	int c;
+
+	init_fold ();
+
+	matcher = g_new0 (NautilusSearchMatcher, 1);
+
+	n = words != NULL ? g_strv_length (words) : 0;
+	matcher->words = g_new0 (guchar *, n + 1);
+	matcher->lengths = g_new0 (gsize, n + 1);
+	matcher->window = G_MAXSIZE;
+
+	for (w = 0; w < n; w++) {
+		length = strlen (words[w]);
+		if (length == 0) {
+			continue;
+		}
+
+		matcher->words[matcher->n_words] = (guchar *) g_ascii_strdown (words[w], length);
+		matcher->lengths[matcher->n_words] = length;
+		matcher->window = MIN (matcher->window, length);
+		matcher->longest = MAX (matcher->longest, length);
+		matcher->n_words++;
+	}
+
+	if (matcher->n_words == 0) {
+		return matcher;
+	}
+
+	for (c = 0; c < 256; c++) {
+		matcher->shift[c] = matcher->window;
+	}
+	for (w = 0; w < matcher->n_words; w++) {
+		for (i = 0; i + 1 < matcher->window; i++) {
+			c = matcher->words[w][i];
+			matcher->shift[c] = MIN (matcher->shift[c], matcher->window - 1 - i);
+		}
+	}
+	for (c = 0; c < 256; c++) {
+		/* Upper case letters in the text move like lower case ones */
+		matcher->shift[c] = matcher->shift[fold[c]];
+	}
+
+	return matcher;
+}
+
+void
+nautilus_search_matcher_free (NautilusSearchMatcher *matcher)
+{
+	guint w;
+
+	for (w = 0; w < matcher->n_words; w++) {
+		g_free (matcher->words[w]);
+	}
+	g_free (matcher->words);
+	g_free (matcher->lengths);
+	g_free (matcher);
+}
+
+guint
+nautilus_search_matcher_get_n_words (NautilusSearchMatcher *matcher)
+{
+	return matcher->n_words;
+}
+
+/* Word at a time, since most names are ASCII only */
+gboolean
+nautilus_search_matcher_is_ascii (const char *str,
+				  gsize length)
+{
+	const char *p, *end;
+	guint64 chunk;
+
+	end = str + length;
+	for (p = str; p + sizeof (chunk) <= end; p += sizeof (chunk)) {
+		memcpy (&chunk, p, sizeof (chunk));
+		if ((chunk & G_GUINT64_CONSTANT (0x8080808080808080)) != 0) {
+			return FALSE;
+		}
+	}
+
+	for (; p < end; p++) {
+		if ((guchar) *p >= 0x80) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static gboolean
+word_at (const guchar *text, const guchar *word, gsize length)
+{
+	gsize i;
+
+	for (i = 0; i < length; i++) {
+		if (fold[text[i]] != word[i]) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* Only counts the occurrences that end after @min_end. Returns early
+ * once every word was seen, if @stop_when_all_found.
+ */
+static void
+scan (NautilusSearchMatcher *matcher,
+      const guchar *p,
+      gsize length,
+      gsize min_end,
+      guint *counts,
+      gboolean stop_when_all_found)
+{
+	gsize pos, window;
+	guint w, n_found;
+
+	window = matcher->window;
+	n_found = 0;
+
+	for (pos = 0; pos + window <= length; pos += matcher->shift[p[pos + window - 1]]) {
+		for (w = 0; w < matcher->n_words; w++) {
+			if (fold[p[pos]] == matcher->words[w][0] &&
+			    pos + matcher->lengths[w] <= length &&
+			    pos + matcher->lengths[w] > min_end &&
+			    word_at (p + pos, matcher->words[w], matcher->lengths[w])) {
+				if (counts[w]++ == 0) {
+					n_found++;
+				}
+				if (stop_when_all_found && n_found == matcher->n_words) {
+					return;
+				}
+			}
+		}
+	}
+}
+
+gboolean
+nautilus_search_matcher_match_all (NautilusSearchMatcher *matcher,
+				   const char *text,
+				   gsize length)
+{
+	guint *counts;
+	guint w;
+
+	if (matcher->n_words == 0) {
+		return TRUE;
+	}
+
+	if (length < matcher->window) {
+		return FALSE;
+	}
+
+	counts = g_newa (guint, matcher->n_words);
+	memset (counts, 0, matcher->n_words * sizeof (guint));
+
+	scan (matcher, (const guchar *) text, length, 0, counts, TRUE);
+
+	for (w = 0; w < matcher->n_words; w++) {
+		if (counts[w] == 0) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+guint
+nautilus_search_matcher_count (NautilusSearchMatcher *matcher,
+			       const char *text,
+			       gsize length,
+			       guint *counts)
+{
+	return nautilus_search_matcher_count_chunk (matcher, text, length, 0, counts);
+}
+
+gsize
+nautilus_search_matcher_get_overlap (NautilusSearchMatcher *matcher)
+{
+	return matcher->longest > 0 ? matcher->longest - 1 : 0;
+}
+
+guint
+nautilus_search_matcher_count_chunk (NautilusSearchMatcher *matcher,
+				     const char *text,
+				     gsize length,
+				     gsize overlap,
+				     guint *counts)
+{
+	guint w, found;
+
+	if (matcher->n_words == 0) {
+		return 0;
+	}
+
+	scan (matcher, (const guchar *) text, length, overlap, counts, FALSE);
+
+	found = 0;
+	for (w = 0; w < matcher->n_words; w++) {
+		if (counts[w] > 0) {
+			found++;
+		}
+	}
+
+	return found;
+}
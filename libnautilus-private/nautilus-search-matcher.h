@@ -0,0 +1,71 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-search-matcher.h: Finding several words in a buffer at once.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef NAUTILUS_SEARCH_MATCHER_H
+#define NAUTILUS_SEARCH_MATCHER_H
+
+#include <glib.h>
+
+typedef struct NautilusSearchMatcher NautilusSearchMatcher;
+
+/* Empty words are ignored. Matching folds ASCII letters to lowercase;
+ * other bytes have to match exactly. A matcher does not change once
+ * created, so it can be shared by search threads.
+ */
+NautilusSearchMatcher *nautilus_search_matcher_new         (char                  **words);
+void                   nautilus_search_matcher_free        (NautilusSearchMatcher  *matcher);
+guint                  nautilus_search_matcher_get_n_words (NautilusSearchMatcher  *matcher);
+
+/* Whether every word occurs in @text; always TRUE without words */
+gboolean               nautilus_search_matcher_match_all   (NautilusSearchMatcher  *matcher,
+							    const char             *text,
+							    gsize                   length);
+
+/* Adds the number of times each word occurs in @text to @counts,
+ * which has room for all the words, and returns the number of words
+ * that occur at least once.
+ */
+guint                  nautilus_search_matcher_count       (NautilusSearchMatcher  *matcher,
+							    const char             *text,
+							    gsize                   length,
+							    guint                  *counts);
+
+/* For text read in chunks: each chunk after the first starts with the
+ * last nautilus_search_matcher_get_overlap() bytes of the one before,
+ * given as @overlap, so that words across the boundary are found.
+ * Occurrences that lie within those bytes were counted with the chunk
+ * before and are not counted again.
+ */
+gsize                  nautilus_search_matcher_get_overlap (NautilusSearchMatcher  *matcher);
+guint                  nautilus_search_matcher_count_chunk (NautilusSearchMatcher  *matcher,
+							    const char             *text,
+							    gsize                   length,
+							    gsize                   overlap,
+							    guint                  *counts);
+
+/* Whether @str is ASCII only. Normalizing and lowercasing such a
+ * name changes nothing the matcher does not ignore anyway, so it can
+ * be matched as it is.
+ */
+gboolean               nautilus_search_matcher_is_ascii    (const char             *str,
+							    gsize                   length);
+
+#endif /* NAUTILUS_SEARCH_MATCHER_H */
@@ -137,6 +137,40 @@ nautilus_search_provider_stop (NautilusSearchProvider *provider)
 	NAUTILUS_SEARCH_PROVIDER_GET_IFACE (provider)->stop (provider);
 }
 
+/* Switches the search that was started to @query, which must be a
+ * refinement of the current query, without starting over: the hits
+ * that no longer match are subtracted, and the search goes on with
+ * @query. Returns FALSE, and leaves everything as it was, if the
+ * provider cannot do that; the search then has to be restarted.
+ */
+gboolean
+nautilus_search_provider_refine_query (NautilusSearchProvider *provider, NautilusQuery *query)
+{
+	g_return_val_if_fail (NAUTILUS_IS_SEARCH_PROVIDER (provider), FALSE);
+
+	if (NAUTILUS_SEARCH_PROVIDER_GET_IFACE (provider)->refine_query == NULL) {
+		return FALSE;
+	}
+
+	return NAUTILUS_SEARCH_PROVIDER_GET_IFACE (provider)->refine_query (provider, query);
+}
+
+/* Whether nautilus_search_provider_refine_query() would switch to
+ * @query. Providers without a check are assumed not to be able to.
+ */
+gboolean
+nautilus_search_provider_can_refine_query (NautilusSearchProvider *provider, NautilusQuery *query)
+{
+	g_return_val_if_fail (NAUTILUS_IS_SEARCH_PROVIDER (provider), FALSE);
+
+	if (NAUTILUS_SEARCH_PROVIDER_GET_IFACE (provider)->refine_query == NULL ||
+	    NAUTILUS_SEARCH_PROVIDER_GET_IFACE (provider)->can_refine_query == NULL) {
+		return FALSE;
+	}
+
+	return NAUTILUS_SEARCH_PROVIDER_GET_IFACE (provider)->can_refine_query (provider, query);
+}
+
 void
 nautilus_search_provider_hits_added (NautilusSearchProvider *provider, GList *hits)
 {
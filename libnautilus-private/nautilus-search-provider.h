@@ -40,6 +40,14 @@ struct _NautilusSearchProviderIface {
         void (*set_query) (NautilusSearchProvider *provider, NautilusQuery *query);
         void (*start) (NautilusSearchProvider *provider);
         void (*stop) (NautilusSearchProvider *provider);
+        /* Optional. Narrows the results of the current search down to
+         * @query, see nautilus_search_provider_refine_query().
+         */
+        gboolean (*refine_query) (NautilusSearchProvider *provider, NautilusQuery *query);
+        /* Optional, along with refine_query. Whether refine_query
+         * would succeed, without changing anything.
+         */
+        gboolean (*can_refine_query) (NautilusSearchProvider *provider, NautilusQuery *query);
 
         /* Signals */
         void (*hits_added) (NautilusSearchProvider *provider, GList *hits);
@@ -55,6 +63,10 @@ void           nautilus_search_provider_set_query       (NautilusSearchProvider
                                                          NautilusQuery *query);
 void           nautilus_search_provider_start           (NautilusSearchProvider *provider);
 void           nautilus_search_provider_stop            (NautilusSearchProvider *provider);
+gboolean       nautilus_search_provider_refine_query    (NautilusSearchProvider *provider,
+                                                         NautilusQuery *query);
+gboolean       nautilus_search_provider_can_refine_query (NautilusSearchProvider *provider,
+                                                          NautilusQuery *query);
 
 void           nautilus_search_provider_hits_added      (NautilusSearchProvider *provider,
                                                          GList *hits);
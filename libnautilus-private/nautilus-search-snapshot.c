@@ -0,0 +1,368 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-search-snapshot.c: On-disk snapshots of saved search results.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+/* A snapshot is a GVariant holding the results a saved search had the
+ * last time it finished, keyed by a checksum of its query. When the
+ * saved search is opened again with the same query, the results in
+ * the snapshot are shown right away, and the search that runs then
+ * adds the new results and takes out the ones it does not find again.
+ */
+
+#include <config.h>
+#include "nautilus-search-snapshot.h"
+
+#include "nautilus-file-private.h"
+#include "nautilus-global-preferences.h"
+#include "nautilus-search-hit.h"
+
+#include <string.h>
+
+#define SNAPSHOT_VERSION 1
+
+#define SNAPSHOT_ENTRY_TYPE "(sdsuutts)"
+#define SNAPSHOT_TYPE "(usa" SNAPSHOT_ENTRY_TYPE ")"
+
+enum {
+	SNAPSHOT_FLAG_HIDDEN = 1 << 0
+};
+
+typedef struct {
+	char *path;
+	char *checksum;
+	GList *hits;
+} LoadJob;
+
+typedef struct {
+	char *path;
+	GVariant *snapshot;
+} SaveJob;
+
+gboolean
+nautilus_search_snapshot_is_enabled (void)
+{
+	return g_settings_get_boolean (nautilus_preferences,
+				       NAUTILUS_PREFERENCES_DIRECTORY_SNAPSHOTS);
+}
+
+static char *
+get_snapshot_path (const char *saved_search_uri)
+{
+	char *checksum, *path;
+
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, saved_search_uri, -1);
+	path = g_build_filename (g_get_user_cache_dir (),
+				 "nautilus", "search-snapshots", checksum, NULL);
+	g_free (checksum);
+
+	return path;
+}
+
+static char *
+get_query_checksum (NautilusQuery *query)
+{
+	char *xml, *checksum;
+
+	xml = nautilus_query_to_xml (query);
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, xml, -1);
+	g_free (xml);
+
+	return checksum;
+}
+
+static NautilusSearchHit *
+hit_from_entry (GVariant *entry)
+{
+	NautilusSearchHit *hit;
+	GFileInfo *info;
+	GFile *location;
+	const char *uri, *display_name, *content_type;
+	char *name;
+	gdouble relevance;
+	guint32 type, flags;
+	guint64 size, mtime;
+
+	g_variant_get (entry, "(&sd&suutt&s)",
+		       &uri, &relevance, &display_name, &type, &flags,
+		       &size, &mtime, &content_type);
+
+	location = g_file_new_for_uri (uri);
+	name = g_file_get_basename (location);
+	g_object_unref (location);
+
+	if (name == NULL) {
+		return NULL;
+	}
+
+	info = g_file_info_new ();
+	g_file_info_set_name (info, name);
+	g_file_info_set_display_name (info, display_name);
+	g_file_info_set_edit_name (info, display_name);
+	g_file_info_set_file_type (info, type);
+	g_file_info_set_is_hidden (info, (flags & SNAPSHOT_FLAG_HIDDEN) != 0);
+	g_file_info_set_size (info, size);
+	g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED, mtime);
+	if (*content_type != '\0') {
+		g_file_info_set_content_type (info, content_type);
+	}
+	g_free (name);
+
+	hit = g_object_new (NAUTILUS_TYPE_SEARCH_HIT,
+			    "uri", uri,
+			    "relevance", relevance,
+			    NULL);
+	nautilus_search_hit_set_file_info (hit, info);
+	g_object_unref (info);
+
+	return hit;
+}
+
+static void
+load_job_free (LoadJob *job)
+{
+	g_free (job->path);
+	g_free (job->checksum);
+	g_list_free_full (job->hits, g_object_unref);
+	g_free (job);
+}
+
+static void
+snapshot_load_thread (GSimpleAsyncResult *res,
+		      GObject *object,
+		      GCancellable *cancellable)
+{
+	LoadJob *job;
+	GVariant *snapshot, *entries, *entry;
+	GVariantIter iter;
+	NautilusSearchHit *hit;
+	char *contents;
+	const char *checksum;
+	gsize length;
+	guint32 version;
+
+	job = g_simple_async_result_get_op_res_gpointer (res);
+
+	if (!g_file_get_contents (job->path, &contents, &length, NULL)) {
+		return;
+	}
+
+	snapshot = g_variant_new_from_data (G_VARIANT_TYPE (SNAPSHOT_TYPE),
+					    contents, length, FALSE,
+					    g_free, contents);
+	g_variant_ref_sink (snapshot);
+	g_variant_get (snapshot, "(u&s@a" SNAPSHOT_ENTRY_TYPE ")",
+		       &version, &checksum, &entries);
+
+	if (version == SNAPSHOT_VERSION &&
+	    strcmp (checksum, job->checksum) == 0) {
+		g_variant_iter_init (&iter, entries);
+		while (!g_cancellable_is_cancelled (cancellable) &&
+		       (entry = g_variant_iter_next_value (&iter)) != NULL) {
+			hit = hit_from_entry (entry);
+			if (hit != NULL) {
+				job->hits = g_list_prepend (job->hits, hit);
+			}
+			g_variant_unref (entry);
+		}
+		job->hits = g_list_reverse (job->hits);
+	}
+
+	g_variant_unref (entries);
+	g_variant_unref (snapshot);
+}
+
+void
+nautilus_search_snapshot_load_async (const char *saved_search_uri,
+				     NautilusQuery *query,
+				     GCancellable *cancellable,
+				     GAsyncReadyCallback callback,
+				     gpointer user_data)
+{
+	GSimpleAsyncResult *res;
+	LoadJob *job;
+
+	job = g_new0 (LoadJob, 1);
+	job->path = get_snapshot_path (saved_search_uri);
+	job->checksum = get_query_checksum (query);
+
+	res = g_simple_async_result_new (NULL, callback, user_data,
+					 nautilus_search_snapshot_load_async);
+	g_simple_async_result_set_op_res_gpointer (res, job, (GDestroyNotify) load_job_free);
+	g_simple_async_result_set_check_cancellable (res, cancellable);
+	g_simple_async_result_run_in_thread (res, snapshot_load_thread,
+					     G_PRIORITY_DEFAULT, cancellable);
+
+	g_object_unref (res);
+}
+
+GList *
+nautilus_search_snapshot_load_finish (GAsyncResult *res,
+				      GError **error)
+{
+	LoadJob *job;
+	GList *hits;
+
+	if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res), error)) {
+		return NULL;
+	}
+
+	job = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (res));
+	hits = job->hits;
+	job->hits = NULL;
+
+	return hits;
+}
+
+static gboolean
+snapshot_save_job (GIOSchedulerJob *io_job,
+		   GCancellable *cancellable,
+		   gpointer user_data)
+{
+	SaveJob *job;
+	char *dirname;
+
+	job = user_data;
+
+	dirname = g_path_get_dirname (job->path);
+	if (g_mkdir_with_parents (dirname, 0700) == 0) {
+		g_file_set_contents (job->path,
+				     g_variant_get_data (job->snapshot),
+				     g_variant_get_size (job->snapshot),
+				     NULL);
+	}
+	g_free (dirname);
+
+	return FALSE;
+}
+
+static void
+save_job_free (gpointer data)
+{
+	SaveJob *job;
+
+	job = data;
+	g_free (job->path);
+	g_variant_unref (job->snapshot);
+	g_free (job);
+}
+
+static gboolean
+add_entry_from_file (GVariantBuilder *builder,
+		     NautilusSearchHit *hit)
+{
+	NautilusFile *file;
+
+	file = nautilus_file_get_existing_by_uri (nautilus_search_hit_get_uri (hit));
+	if (file == NULL) {
+		return FALSE;
+	}
+
+	if (!file->details->got_file_info || file->details->is_gone) {
+		nautilus_file_unref (file);
+		return FALSE;
+	}
+
+	g_variant_builder_add (builder, SNAPSHOT_ENTRY_TYPE,
+			       nautilus_search_hit_get_uri (hit),
+			       nautilus_search_hit_get_relevance (hit),
+			       file->details->display_name != NULL ?
+			       eel_ref_str_peek (file->details->display_name) :
+			       eel_ref_str_peek (file->details->name),
+			       (guint32) file->details->type,
+			       file->details->is_hidden ? SNAPSHOT_FLAG_HIDDEN : 0,
+			       (guint64) MAX (file->details->size, 0),
+			       (guint64) file->details->mtime,
+			       file->details->mime_type != NULL ?
+			       eel_ref_str_peek (file->details->mime_type) : "");
+	nautilus_file_unref (file);
+
+	return TRUE;
+}
+
+/* Hits that are held back have no NautilusFile, but the engine may
+ * have given them the info it found them with.
+ */
+static gboolean
+add_entry_from_info (GVariantBuilder *builder,
+		     NautilusSearchHit *hit)
+{
+	GFileInfo *info;
+	const char *display_name, *content_type;
+
+	info = nautilus_search_hit_get_file_info (hit);
+	if (info == NULL) {
+		return FALSE;
+	}
+
+	display_name = g_file_info_get_display_name (info);
+	content_type = NULL;
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE)) {
+		content_type = g_file_info_get_content_type (info);
+	}
+
+	g_variant_builder_add (builder, SNAPSHOT_ENTRY_TYPE,
+			       nautilus_search_hit_get_uri (hit),
+			       nautilus_search_hit_get_relevance (hit),
+			       display_name != NULL ? display_name : g_file_info_get_name (info),
+			       (guint32) g_file_info_get_file_type (info),
+			       g_file_info_get_is_hidden (info) ? SNAPSHOT_FLAG_HIDDEN : 0,
+			       (guint64) MAX (g_file_info_get_size (info), 0),
+			       g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+			       content_type != NULL ? content_type : "");
+
+	return TRUE;
+}
+
+void
+nautilus_search_snapshot_save (const char *saved_search_uri,
+			       NautilusQuery *query,
+			       GList *hits)
+{
+	GVariantBuilder builder;
+	NautilusSearchHit *hit;
+	SaveJob *job;
+	char *checksum;
+	GList *l;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a" SNAPSHOT_ENTRY_TYPE));
+
+	for (l = hits; l != NULL; l = l->next) {
+		hit = l->data;
+
+		if (!add_entry_from_file (&builder, hit)) {
+			add_entry_from_info (&builder, hit);
+		}
+	}
+
+	checksum = get_query_checksum (query);
+
+	job = g_new0 (SaveJob, 1);
+	job->path = get_snapshot_path (saved_search_uri);
+	job->snapshot = g_variant_ref_sink (g_variant_new ("(us@a" SNAPSHOT_ENTRY_TYPE ")",
+							   SNAPSHOT_VERSION, checksum,
+							   g_variant_builder_end (&builder)));
+	g_free (checksum);
+
+	g_io_scheduler_push_job (snapshot_save_job,
+				 job,
+				 save_job_free,
+				 G_PRIORITY_LOW,
+				 NULL);
+}
@@ -0,0 +1,52 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * nautilus-search-snapshot.h: On-disk snapshots of saved search results.
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef NAUTILUS_SEARCH_SNAPSHOT_H
+#define NAUTILUS_SEARCH_SNAPSHOT_H
+
+#include <gio/gio.h>
+#include <libnautilus-private/nautilus-query.h>
+
+gboolean nautilus_search_snapshot_is_enabled  (void);
+
+/* Reads the snapshot of the saved search at @saved_search_uri in a
+ * thread. The result is a list of NautilusSearchHits with relevance
+ * and a GFileInfo holding name, type, size, modification time and
+ * content type, or NULL if there is no snapshot or it was taken for
+ * another query than @query. Fails with G_IO_ERROR_CANCELLED if
+ * @cancellable was cancelled, even after the snapshot was read.
+ */
+void     nautilus_search_snapshot_load_async  (const char           *saved_search_uri,
+					       NautilusQuery        *query,
+					       GCancellable         *cancellable,
+					       GAsyncReadyCallback   callback,
+					       gpointer              user_data);
+GList *  nautilus_search_snapshot_load_finish (GAsyncResult         *res,
+					       GError              **error);
+
+/* Takes a snapshot of @hits, the results of @query, and writes it out
+ * in a thread. Hits whose file info is not known are left out.
+ */
+void     nautilus_search_snapshot_save        (const char           *saved_search_uri,
+					       NautilusQuery        *query,
+					       GList                *hits);
+
+#endif /* NAUTILUS_SEARCH_SNAPSHOT_H */
@@ -34,8 +34,8 @@
 #include <gtk/gtk.h>
 
 #include <libegg/eggtreemultidnd.h>
-#include <eel/eel-graphic-effects.h>
 #include <libnautilus-private/nautilus-dnd.h>
+#include <libnautilus-private/nautilus-icon-effects.h>
 
 enum {
 	SUBDIRECTORY_UNLOADED,
@@ -340,7 +340,7 @@ nautilus_list_model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, int
 			    g_list_find_custom (model->details->highlight_files,
 			                        file, (GCompareFunc) nautilus_file_compare_location))
 			{
-				rendered_icon = eel_create_spotlight_pixbuf (icon);
+				rendered_icon = nautilus_icon_effects_apply (icon, NAUTILUS_ICON_EFFECT_SPOTLIGHT, NULL);
 
 				if (rendered_icon != NULL) {
 					g_object_unref (icon);
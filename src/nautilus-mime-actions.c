@@ -39,6 +39,7 @@
 #include <libnautilus-private/nautilus-file-attributes.h>
 #include <libnautilus-private/nautilus-file.h>
 #include <libnautilus-private/nautilus-file-operations.h>
+#include <libnautilus-private/nautilus-file-utilities.h>
 #include <libnautilus-private/nautilus-metadata.h>
 #include <libnautilus-private/nautilus-program-choosing.h>
 #include <libnautilus-private/nautilus-desktop-icon-file.h>
@@ -1213,7 +1214,7 @@ show_unhandled_type_error (ActivateParametersInstall *parameters)
 			      NULL);
 	} else {
 		char *text;
-		text = g_strdup_printf (_("There is no application installed for %s files"), g_content_type_get_description (mime_type));
+		text = g_strdup_printf (_("There is no application installed for %s files"), nautilus_get_content_type_description (mime_type));
 
 		dialog = gtk_message_dialog_new (parameters->parent_window,
 						 GTK_DIALOG_DESTROY_WITH_PARENT,
@@ -1387,7 +1388,7 @@ pk_proxy_appeared_cb (GObject *source,
 	gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (dialog),
 	                                          _("There is no application installed for %s files.\n"
 	                                            "Do you want to search for an application to open this file?"),
-	                                          g_content_type_get_description (mime_type));
+	                                          nautilus_get_content_type_description (mime_type));
 	gtk_window_set_resizable (GTK_WINDOW (dialog), FALSE);
 
 	parameters_install->dialog = dialog;
@@ -32,6 +32,7 @@
 
 #include <eel/eel-glib-extensions.h>
 #include <libnautilus-private/nautilus-file-utilities.h>
+#include <libnautilus-private/nautilus-global-preferences.h>
 
 typedef enum {
 	NAUTILUS_QUERY_EDITOR_ROW_TYPE,
@@ -1139,6 +1140,9 @@ nautilus_query_editor_get_query (NautilusQueryEditor *editor)
 
 	query = nautilus_query_new ();
 	nautilus_query_set_text (query, query_text);
+	nautilus_query_set_search_content (query,
+					   g_settings_get_boolean (nautilus_preferences,
+								   NAUTILUS_PREFERENCES_SEARCH_FILE_CONTENTS));
 
 	add_location_to_query (editor, query);
 
@@ -0,0 +1,199 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+
+#include "nautilus-search-more-bar.h"
+
+#define NAUTILUS_SEARCH_MORE_BAR_GET_PRIVATE(o)\
+	(G_TYPE_INSTANCE_GET_PRIVATE ((o), NAUTILUS_TYPE_SEARCH_MORE_BAR, NautilusSearchMoreBarPrivate))
+
+enum {
+	PROP_DIRECTORY = 1,
+	NUM_PROPERTIES
+};
+
+enum {
+	SEARCH_MORE_BAR_RESPONSE_SHOW_MORE = 1
+};
+
+struct NautilusSearchMoreBarPrivate
+{
+	NautilusSearchDirectory *directory;
+	GtkWidget *label;
+	GtkWidget *more_button;
+};
+
+G_DEFINE_TYPE (NautilusSearchMoreBar, nautilus_search_more_bar, GTK_TYPE_INFO_BAR);
+
+/* The bar is only visible while some results are held back, or when
+ * the search gave up before looking everywhere.
+ */
+static void
+update_visibility (NautilusSearchMoreBar *bar)
+{
+	gboolean has_more, incomplete;
+
+	has_more = nautilus_search_directory_has_more_results (bar->priv->directory);
+	incomplete = nautilus_search_directory_is_incomplete (bar->priv->directory);
+
+	if (incomplete) {
+		gtk_label_set_text (GTK_LABEL (bar->priv->label),
+				    _("Some folders were skipped to keep the search short."));
+	} else {
+		gtk_label_set_text (GTK_LABEL (bar->priv->label),
+				    _("Only the most relevant results are shown."));
+	}
+
+	gtk_widget_set_visible (bar->priv->more_button, has_more);
+	gtk_widget_set_visible (GTK_WIDGET (bar), has_more || incomplete);
+}
+
+static void
+set_directory (NautilusSearchMoreBar *bar,
+	       NautilusSearchDirectory *directory)
+{
+	bar->priv->directory = NAUTILUS_SEARCH_DIRECTORY (nautilus_directory_ref (NAUTILUS_DIRECTORY (directory)));
+
+	g_signal_connect_object (directory, "files-added",
+				 G_CALLBACK (update_visibility), bar,
+				 G_CONNECT_SWAPPED);
+	g_signal_connect_object (directory, "files-changed",
+				 G_CALLBACK (update_visibility), bar,
+				 G_CONNECT_SWAPPED);
+	g_signal_connect_object (directory, "done-loading",
+				 G_CALLBACK (update_visibility), bar,
+				 G_CONNECT_SWAPPED);
+
+	update_visibility (bar);
+}
+
+static void
+nautilus_search_more_bar_set_property (GObject      *object,
+				       guint         prop_id,
+				       const GValue *value,
+				       GParamSpec   *pspec)
+{
+	NautilusSearchMoreBar *bar;
+
+	bar = NAUTILUS_SEARCH_MORE_BAR (object);
+
+	switch (prop_id) {
+	case PROP_DIRECTORY:
+		set_directory (bar, g_value_get_object (value));
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+		break;
+	}
+}
+
+static void
+nautilus_search_more_bar_dispose (GObject *obj)
+{
+	NautilusSearchMoreBar *bar;
+
+	bar = NAUTILUS_SEARCH_MORE_BAR (obj);
+
+	if (bar->priv->directory != NULL) {
+		nautilus_directory_unref (NAUTILUS_DIRECTORY (bar->priv->directory));
+		bar->priv->directory = NULL;
+	}
+
+	G_OBJECT_CLASS (nautilus_search_more_bar_parent_class)->dispose (obj);
+}
+
+static void
+nautilus_search_more_bar_class_init (NautilusSearchMoreBarClass *klass)
+{
+	GObjectClass *object_class;
+
+	object_class = G_OBJECT_CLASS (klass);
+
+	object_class->set_property = nautilus_search_more_bar_set_property;
+	object_class->dispose = nautilus_search_more_bar_dispose;
+
+	g_object_class_install_property (object_class,
+					 PROP_DIRECTORY,
+					 g_param_spec_object ("directory",
+							      "directory",
+							      "the NautilusSearchDirectory",
+							      NAUTILUS_TYPE_SEARCH_DIRECTORY,
+							      G_PARAM_WRITABLE |
+							      G_PARAM_CONSTRUCT_ONLY |
+							      G_PARAM_STATIC_STRINGS));
+
+	g_type_class_add_private (klass, sizeof (NautilusSearchMoreBarPrivate));
+}
+
+static void
+search_more_bar_response_cb (GtkInfoBar *infobar,
+			     gint response_id,
+			     gpointer user_data)
+{
+	NautilusSearchMoreBar *bar;
+
+	bar = NAUTILUS_SEARCH_MORE_BAR (infobar);
+
+	switch (response_id) {
+	case SEARCH_MORE_BAR_RESPONSE_SHOW_MORE:
+		nautilus_search_directory_load_more_results (bar->priv->directory);
+		update_visibility (bar);
+		break;
+	default:
+		break;
+	}
+}
+
+static void
+nautilus_search_more_bar_init (NautilusSearchMoreBar *bar)
+{
+	GtkWidget *content_area, *action_area;
+
+	bar->priv = NAUTILUS_SEARCH_MORE_BAR_GET_PRIVATE (bar);
+	content_area = gtk_info_bar_get_content_area (GTK_INFO_BAR (bar));
+	action_area = gtk_info_bar_get_action_area (GTK_INFO_BAR (bar));
+
+	gtk_orientable_set_orientation (GTK_ORIENTABLE (action_area),
+					GTK_ORIENTATION_HORIZONTAL);
+
+	bar->priv->label = gtk_label_new (_("Only the most relevant results are shown."));
+	gtk_widget_show (bar->priv->label);
+	gtk_container_add (GTK_CONTAINER (content_area), bar->priv->label);
+
+	bar->priv->more_button = gtk_info_bar_add_button (GTK_INFO_BAR (bar),
+							  _("Show More Results"),
+							  SEARCH_MORE_BAR_RESPONSE_SHOW_MORE);
+	gtk_widget_set_tooltip_text (bar->priv->more_button,
+				     _("Show the next most relevant results"));
+
+	g_signal_connect (bar, "response",
+			  G_CALLBACK (search_more_bar_response_cb), bar);
+}
+
+GtkWidget *
+nautilus_search_more_bar_new (NautilusSearchDirectory *directory)
+{
+	return g_object_new (NAUTILUS_TYPE_SEARCH_MORE_BAR,
+			     "directory", directory,
+			     "message-type", GTK_MESSAGE_INFO,
+			     NULL);
+}
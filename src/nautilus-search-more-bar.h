@@ -0,0 +1,54 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef __NAUTILUS_SEARCH_MORE_BAR_H
+#define __NAUTILUS_SEARCH_MORE_BAR_H
+
+#include <gtk/gtk.h>
+#include <libnautilus-private/nautilus-search-directory.h>
+
+G_BEGIN_DECLS
+
+#define NAUTILUS_TYPE_SEARCH_MORE_BAR         (nautilus_search_more_bar_get_type ())
+#define NAUTILUS_SEARCH_MORE_BAR(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), NAUTILUS_TYPE_SEARCH_MORE_BAR, NautilusSearchMoreBar))
+#define NAUTILUS_SEARCH_MORE_BAR_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST((k), NAUTILUS_TYPE_SEARCH_MORE_BAR, NautilusSearchMoreBarClass))
+#define NAUTILUS_IS_SEARCH_MORE_BAR(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), NAUTILUS_TYPE_SEARCH_MORE_BAR))
+#define NAUTILUS_IS_SEARCH_MORE_BAR_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), NAUTILUS_TYPE_SEARCH_MORE_BAR))
+#define NAUTILUS_SEARCH_MORE_BAR_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), NAUTILUS_TYPE_SEARCH_MORE_BAR, NautilusSearchMoreBarClass))
+
+typedef struct NautilusSearchMoreBarPrivate NautilusSearchMoreBarPrivate;
+
+typedef struct
+{
+	GtkInfoBar parent;
+
+	NautilusSearchMoreBarPrivate *priv;
+} NautilusSearchMoreBar;
+
+typedef struct
+{
+	GtkInfoBarClass parent_class;
+} NautilusSearchMoreBarClass;
+
+GType		 nautilus_search_more_bar_get_type	(void) G_GNUC_CONST;
+
+GtkWidget       *nautilus_search_more_bar_new         (NautilusSearchDirectory *directory);
+
+G_END_DECLS
+
+#endif /* __NAUTILUS_SEARCH_MORE_BAR_H */
@@ -30,11 +30,10 @@
 
 #include "nautilus-tree-sidebar-model.h"
 
-#include <eel/eel-graphic-effects.h>
-
 #include <libnautilus-private/nautilus-directory.h>
 #include <libnautilus-private/nautilus-file-attributes.h>
 #include <libnautilus-private/nautilus-file.h>
+#include <libnautilus-private/nautilus-icon-effects.h>
 
 #include <glib/gi18n.h>
 #include <gtk/gtk.h>
@@ -73,6 +72,8 @@ struct TreeNode {
 	TreeNode *parent;
 	TreeNode *next;
 	TreeNode *prev;
+	/* position in the children of the parent, not set for roots */
+	GSequenceIter *child_ptr;
 
 	/* part of the node used only for directories */
 	int dummy_child_ref_count;
@@ -84,6 +85,10 @@ struct TreeNode {
 	guint files_changed_id;
 
 	TreeNode *first_child;
+	/* the same nodes as the sibling list, in the same order, to find
+	 * the index of a child or the child at an index quickly.
+	 */
+	GSequence *children;
 
 	/* misc. flags */
 	guint done_loading : 1;
@@ -111,6 +116,14 @@ struct FMTreeModelRoot {
 	GHashTable *file_to_node_map;
 	
 	TreeNode *root_node;
+
+	/* Changed files not processed yet, in the order they came in.
+	 * A burst of changes is reported at once, with each file only
+	 * processed once.
+	 */
+	GQueue changed_files;
+	GHashTable *changed_file_set;
+	guint changed_files_idle_id;
 };
 
 typedef struct {
@@ -152,10 +165,25 @@ tree_model_root_new (FMTreeModel *model)
 	root = g_new0 (FMTreeModelRoot, 1);
 	root->model = model;
 	root->file_to_node_map = g_hash_table_new (NULL, NULL);
+	root->changed_file_set = g_hash_table_new (NULL, NULL);
 
 	return root;
 }
 
+static void
+tree_model_root_free (FMTreeModelRoot *root)
+{
+	if (root->changed_files_idle_id != 0) {
+		g_source_remove (root->changed_files_idle_id);
+	}
+	g_queue_foreach (&root->changed_files, (GFunc) nautilus_file_unref, NULL);
+	g_queue_clear (&root->changed_files);
+	g_hash_table_destroy (root->changed_file_set);
+
+	g_hash_table_destroy (root->file_to_node_map);
+	g_free (root);
+}
+
 static TreeNode *
 tree_node_new (NautilusFile *file, FMTreeModelRoot *root)
 {
@@ -192,6 +220,11 @@ tree_node_unparent (FMTreeModel *model, TreeNode *node)
 		prev->next = next;
 	}
 
+	if (node->child_ptr != NULL) {
+		g_sequence_remove (node->child_ptr);
+		node->child_ptr = NULL;
+	}
+
 	node->parent = NULL;
 	node->next = NULL;
 	node->prev = NULL;
@@ -206,6 +239,10 @@ tree_node_destroy (FMTreeModel *model, TreeNode *node)
 
 	tree_node_unparent (model, node);
 
+	if (node->children != NULL) {
+		g_sequence_free (node->children);
+	}
+
 	g_object_unref (node->file);
 	g_free (node->display_name);
 	object_unref_if_not_NULL (node->icon);
@@ -242,6 +279,11 @@ tree_node_parent (TreeNode *node, TreeNode *parent)
 	}
 
 	parent->first_child = node;
+
+	if (parent->children == NULL) {
+		parent->children = g_sequence_new (NULL);
+	}
+	node->child_ptr = g_sequence_prepend (parent->children, node);
 }
 
 static GdkPixbuf *
@@ -307,7 +349,7 @@ get_menu_icon_for_file (TreeNode *node,
 	                                 file, (GCompareFunc) nautilus_file_compare_location) != NULL);
 
 	if (highlight) {
-		pixbuf = eel_create_spotlight_pixbuf (retval);
+		pixbuf = nautilus_icon_effects_apply (retval, NAUTILUS_ICON_EFFECT_SPOTLIGHT, NULL);
 
 		if (pixbuf != NULL) {
 			g_object_unref (retval);
@@ -426,22 +468,16 @@ static int
 tree_node_get_child_index (TreeNode *parent, TreeNode *child)
 {
 	int i;
-	TreeNode *node;
 
 	if (child == NULL) {
 		g_assert (tree_node_has_dummy_child (parent));
 		return 0;
 	}
 
-	i = tree_node_has_dummy_child (parent) ? 1 : 0;
-	for (node = parent->first_child; node != NULL; node = node->next, i++) {
-		if (child == node) {
-			return i;
-		}
-	}
+	g_assert (child->parent == parent);
 
-	g_assert_not_reached ();
-	return 0;
+	i = tree_node_has_dummy_child (parent) ? 1 : 0;
+	return i + g_sequence_iter_get_position (child->child_ptr);
 }
 
 static gboolean
@@ -968,21 +1004,72 @@ process_file_change (FMTreeModelRoot *root,
 		return;
 	}
 
+	/* The change came in before the parent was collapsed */
+	if (parent->done_loading_id == 0) {
+		return;
+	}
+
 	insert_node (root->model, parent, create_node_for_file (root, file));
 }
 
+static void
+process_file_changes (FMTreeModelRoot *root)
+{
+	NautilusFile *file;
+
+	if (root->changed_files_idle_id != 0) {
+		g_source_remove (root->changed_files_idle_id);
+		root->changed_files_idle_id = 0;
+	}
+
+	while ((file = g_queue_pop_head (&root->changed_files)) != NULL) {
+		g_hash_table_remove (root->changed_file_set, file);
+		process_file_change (root, file);
+		nautilus_file_unref (file);
+	}
+}
+
+static gboolean
+process_file_changes_idle_callback (gpointer callback_data)
+{
+	FMTreeModelRoot *root;
+
+	root = (FMTreeModelRoot *) (callback_data);
+	root->changed_files_idle_id = 0;
+
+	process_file_changes (root);
+
+	return FALSE;
+}
+
 static void
 files_changed_callback (NautilusDirectory *directory,
 			GList *changed_files,
 			gpointer callback_data)
 {
 	FMTreeModelRoot *root;
+	NautilusFile *file;
 	GList *node;
 
 	root = (FMTreeModelRoot *) (callback_data);
 
 	for (node = changed_files; node != NULL; node = node->next) {
-		process_file_change (root, NAUTILUS_FILE (node->data));
+		file = NAUTILUS_FILE (node->data);
+		if (!g_hash_table_contains (root->changed_file_set, file)) {
+			g_hash_table_add (root->changed_file_set, file);
+			g_queue_push_tail (&root->changed_files, nautilus_file_ref (file));
+		}
+	}
+
+	/* Report the changes once the burst is over, before the
+	 * tree view gets to lay out and draw again.
+	 */
+	if (root->changed_files_idle_id == 0 &&
+	    !g_queue_is_empty (&root->changed_files)) {
+		root->changed_files_idle_id =
+			g_idle_add_full (G_PRIORITY_HIGH_IDLE,
+					 process_file_changes_idle_callback,
+					 root, NULL);
 	}
 }
 
@@ -1026,6 +1113,9 @@ done_loading_callback (NautilusDirectory *directory,
 	TreeNode *node;
 	GtkTreeIter iter;
 
+	/* Have all the children in before the dummy row goes away */
+	process_file_changes (root);
+
 	file = nautilus_directory_get_corresponding_file (directory);
 	node = get_node_from_file (root, file);
 	if (node == NULL) {
@@ -1343,7 +1433,7 @@ fm_tree_model_iter_has_child (GtkTreeModel *model, GtkTreeIter *iter)
 static int
 fm_tree_model_iter_n_children (GtkTreeModel *model, GtkTreeIter *iter)
 {
-	TreeNode *parent, *node;
+	TreeNode *parent;
 	int n;
 	
 	g_return_val_if_fail (FM_IS_TREE_MODEL (model), FALSE);
@@ -1359,8 +1449,8 @@ fm_tree_model_iter_n_children (GtkTreeModel *model, GtkTreeIter *iter)
 	}
 
 	n = tree_node_has_dummy_child (parent) ? 1 : 0;
-	for (node = parent->first_child; node != NULL; node = node->next) {
-		n++;
+	if (parent->children != NULL) {
+		n += g_sequence_get_length (parent->children);
 	}
 
 	return n;
@@ -1396,11 +1486,11 @@ fm_tree_model_iter_nth_child (GtkTreeModel *model, GtkTreeIter *iter,
 	if (n == 0 && i == 1) {
 		return make_iter_for_dummy_row (parent, iter, parent_iter->stamp);
 	}
-	for (node = parent->first_child; i != n; i++, node = node->next) {
-		if (node == NULL) {
-			return make_iter_invalid (iter);
-		}
+	if (parent->children == NULL ||
+	    n - i < 0 || n - i >= g_sequence_get_length (parent->children)) {
+		return make_iter_invalid (iter);
 	}
+	node = g_sequence_get (g_sequence_get_iter_at_pos (parent->children, n - i));
 
 	return make_iter_for_node (node, iter, parent_iter->stamp);	
 }
@@ -1635,8 +1725,7 @@ fm_tree_model_remove_root_uri (FMTreeModel *model, const char *uri)
 		/* destroy the root identifier */
 		root = node->root;
 		destroy_node_without_reporting (model, node);
-		g_hash_table_destroy (root->file_to_node_map);
-		g_free (root);
+		tree_model_root_free (root);
 	}
 }
 
@@ -1845,8 +1934,7 @@ fm_tree_model_finalize (GObject *object)
 		next_root = root_node->next;
 		root = root_node->root;
 		destroy_node_without_reporting (model, root_node);
-		g_hash_table_destroy (root->file_to_node_map);
-		g_free (root);
+		tree_model_root_free (root);
 	}
 
 	if (model->details->monitoring_update_idle_id != 0) {
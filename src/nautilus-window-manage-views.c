@@ -35,6 +35,7 @@
 #include "nautilus-pathbar.h"
 #include "nautilus-window-private.h"
 #include "nautilus-window-slot.h"
+#include "nautilus-search-more-bar.h"
 #include "nautilus-special-location-bar.h"
 #include "nautilus-trash-bar.h"
 #include "nautilus-toolbar.h"
@@ -1311,6 +1312,18 @@ nautilus_window_slot_show_special_location_bar (NautilusWindowSlot     *slot,
 	nautilus_window_slot_add_extra_location_widget (slot, bar);
 }
 
+static void
+nautilus_window_slot_show_search_more_bar (NautilusWindowSlot *slot,
+					   NautilusDirectory *directory)
+{
+	GtkWidget *bar;
+
+	/* Shows itself once there are more results */
+	bar = nautilus_search_more_bar_new (NAUTILUS_SEARCH_DIRECTORY (directory));
+
+	nautilus_window_slot_add_extra_location_widget (slot, bar);
+}
+
 static void
 nautilus_window_slot_show_trash_bar (NautilusWindowSlot *slot)
 {
@@ -1445,6 +1458,8 @@ update_for_new_location (NautilusWindowSlot *slot)
 
 		if (nautilus_directory_is_in_trash (directory)) {
 			nautilus_window_slot_show_trash_bar (slot);
+		} else if (NAUTILUS_IS_SEARCH_DIRECTORY (directory)) {
+			nautilus_window_slot_show_search_more_bar (slot, directory);
 		} else {
 			GFile *scripts_file;
 			char *scripts_path = nautilus_get_scripts_directory_path ();
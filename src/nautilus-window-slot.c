@@ -95,7 +95,8 @@ sync_search_directory (NautilusWindowSlot *slot)
 		slot->load_with_search = TRUE;
 		nautilus_window_slot_open_location (slot, location, 0);
 		g_object_unref (location);
-	} else {
+	} else if (!nautilus_search_directory_refine_query (NAUTILUS_SEARCH_DIRECTORY (directory),
+							   query)) {
 		nautilus_search_directory_set_query (NAUTILUS_SEARCH_DIRECTORY (directory),
 						     query);
 		nautilus_window_slot_reload (slot);
@@ -0,0 +1,232 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+
+/* Measures the throughput of the spotlight and colorize effects with
+ * each set of pixel kernels the processor supports, and checks that
+ * they all give the same pixels. Widths that are not a multiple of
+ * the vector width, and rows with padding after them, are only
+ * checked.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <eel/eel-graphic-effects.h>
+
+#define TARGET_USEC (G_USEC_PER_SEC / 4)
+
+static const int sizes[] = { 16, 24, 32, 48, 64, 96, 128, 256, 512 };
+
+/* These leave a tail for the scalar code after the vector loop */
+static const int odd_sizes[] = { 1, 7, 15, 33 };
+
+/* Bytes after each row of the padded pixbufs, so that rows do not
+ * start aligned either.
+ */
+#define ROW_PADDING 13
+
+static const struct {
+	EelPixelKernels kernels;
+	const char *name;
+} kernels[] = {
+	{ EEL_PIXEL_KERNELS_SCALAR, "scalar" },
+	{ EEL_PIXEL_KERNELS_SSE2, "sse2" },
+	{ EEL_PIXEL_KERNELS_AVX2, "avx2" }
+};
+
+static void
+free_pixels (guchar *pixels, gpointer data)
+{
+	g_free (pixels);
+}
+
+static GdkPixbuf *
+create_test_pixbuf (int size, gboolean has_alpha, gboolean padded)
+{
+	GdkPixbuf *pixbuf;
+	guchar *pixels;
+	int rowstride, n_channels, x, y, i;
+	GRand *rand;
+
+	rand = g_rand_new_with_seed (size);
+	if (padded) {
+		n_channels = has_alpha ? 4 : 3;
+		rowstride = size * n_channels + ROW_PADDING;
+		pixels = g_malloc0 (rowstride * size);
+		pixbuf = gdk_pixbuf_new_from_data (pixels, GDK_COLORSPACE_RGB, has_alpha, 8,
+						   size, size, rowstride, free_pixels, NULL);
+	} else {
+		pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, has_alpha, 8, size, size);
+		pixels = gdk_pixbuf_get_pixels (pixbuf);
+		rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+		n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+	}
+
+	for (y = 0; y < size; y++) {
+		for (x = 0; x < size; x++) {
+			for (i = 0; i < n_channels; i++) {
+				pixels[y * rowstride + x * n_channels + i] = g_rand_int_range (rand, 0, 256);
+			}
+		}
+	}
+
+	g_rand_free (rand);
+
+	return pixbuf;
+}
+
+static gboolean
+pixbufs_equal (GdkPixbuf *a, GdkPixbuf *b)
+{
+	int y, row_length;
+
+	row_length = gdk_pixbuf_get_width (a) * gdk_pixbuf_get_n_channels (a);
+	for (y = 0; y < gdk_pixbuf_get_height (a); y++) {
+		if (memcmp (gdk_pixbuf_get_pixels (a) + y * gdk_pixbuf_get_rowstride (a),
+			    gdk_pixbuf_get_pixels (b) + y * gdk_pixbuf_get_rowstride (b),
+			    row_length) != 0) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static GdkPixbuf *
+apply_effect (GdkPixbuf *pixbuf, gboolean colorize)
+{
+	GdkRGBA color = { 0.29, 0.56, 0.85, 1.0 };
+
+	if (colorize) {
+		return eel_create_colorized_pixbuf (pixbuf, &color);
+	}
+
+	return eel_create_spotlight_pixbuf (pixbuf);
+}
+
+/* Returns megapixels per second */
+static double
+measure (GdkPixbuf *pixbuf, gboolean colorize)
+{
+	gint64 start, elapsed;
+	int n_runs;
+
+	n_runs = 0;
+	start = g_get_monotonic_time ();
+	do {
+		g_object_unref (apply_effect (pixbuf, colorize));
+		n_runs++;
+		elapsed = g_get_monotonic_time () - start;
+	} while (elapsed < TARGET_USEC);
+
+	return (double) n_runs * gdk_pixbuf_get_width (pixbuf) * gdk_pixbuf_get_height (pixbuf) / elapsed;
+}
+
+/* Only checks that every set of kernels gives the scalar pixels */
+static gboolean
+check (int size, gboolean has_alpha, gboolean padded, gboolean colorize)
+{
+	GdkPixbuf *pixbuf, *expected, *result;
+	gboolean ok;
+	guint k;
+
+	pixbuf = create_test_pixbuf (size, has_alpha, padded);
+
+	eel_graphic_effects_use_kernels (EEL_PIXEL_KERNELS_SCALAR);
+	expected = apply_effect (pixbuf, colorize);
+
+	ok = TRUE;
+	for (k = 0; k < G_N_ELEMENTS (kernels); k++) {
+		if (!eel_graphic_effects_use_kernels (kernels[k].kernels)) {
+			continue;
+		}
+
+		result = apply_effect (pixbuf, colorize);
+		if (!pixbufs_equal (expected, result)) {
+			g_print ("%s, %dx%d%s%s: %s differs\n",
+				 colorize ? "colorize" : "spotlight",
+				 size, size,
+				 has_alpha ? ", alpha" : "",
+				 padded ? ", padded rows" : "",
+				 kernels[k].name);
+			ok = FALSE;
+		}
+		g_object_unref (result);
+	}
+
+	g_object_unref (expected);
+	g_object_unref (pixbuf);
+
+	return ok;
+}
+
+int
+main (int argc, char *argv[])
+{
+	GdkPixbuf *pixbuf, *expected, *result;
+	gboolean has_alpha, colorize, failed;
+	guint i, k;
+
+	g_type_init ();
+
+	failed = FALSE;
+
+	for (colorize = FALSE; colorize <= TRUE; colorize++) {
+		for (has_alpha = TRUE; has_alpha >= FALSE; has_alpha--) {
+			for (i = 0; i < G_N_ELEMENTS (odd_sizes); i++) {
+				if (!check (odd_sizes[i], has_alpha, FALSE, colorize) ||
+				    !check (odd_sizes[i], has_alpha, TRUE, colorize)) {
+					failed = TRUE;
+				}
+			}
+			for (i = 0; i < G_N_ELEMENTS (sizes); i++) {
+				if (!check (sizes[i], has_alpha, TRUE, colorize)) {
+					failed = TRUE;
+				}
+			}
+		}
+	}
+
+	g_print ("%-9s %5s %-5s", "effect", "size", "alpha");
+	for (k = 0; k < G_N_ELEMENTS (kernels); k++) {
+		g_print (" %10s", kernels[k].name);
+	}
+	g_print ("  (megapixels/s)\n");
+
+	for (colorize = FALSE; colorize <= TRUE; colorize++) {
+		for (has_alpha = TRUE; has_alpha >= FALSE; has_alpha--) {
+			for (i = 0; i < G_N_ELEMENTS (sizes); i++) {
+				pixbuf = create_test_pixbuf (sizes[i], has_alpha, FALSE);
+
+				eel_graphic_effects_use_kernels (EEL_PIXEL_KERNELS_SCALAR);
+				expected = apply_effect (pixbuf, colorize);
+
+				g_print ("%-9s %5d %-5s",
+					 colorize ? "colorize" : "spotlight",
+					 sizes[i], has_alpha ? "yes" : "no");
+
+				for (k = 0; k < G_N_ELEMENTS (kernels); k++) {
+					if (!eel_graphic_effects_use_kernels (kernels[k].kernels)) {
+						g_print (" %10s", "-");
+						continue;
+					}
+
+					result = apply_effect (pixbuf, colorize);
+					if (!pixbufs_equal (expected, result)) {
+						g_print (" %10s", "MISMATCH");
+						failed = TRUE;
+					} else {
+						g_print (" %10.1f", measure (pixbuf, colorize));
+					}
+					g_object_unref (result);
+				}
+				g_print ("\n");
+
+				g_object_unref (expected);
+				g_object_unref (pixbuf);
+			}
+		}
+	}
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+
+/* Checks NautilusSearchMatcher on the edge cases of reading files in
+ * chunks the way the simple search engine does: words across a chunk
+ * boundary, empty text, and words longer than the text. Every text is
+ * counted in chunks of every size and compared with counting it whole.
+ */
+
+#include <config.h>
+
+#include <glib.h>
+#include <string.h>
+#include <libnautilus-private/nautilus-search-matcher.h>
+
+static gboolean failed;
+
+/* Feeds @text to the matcher @chunk_size bytes at a time, keeping
+ * the overlap in front of each chunk like the content readers do.
+ */
+static guint
+count_in_chunks (NautilusSearchMatcher *matcher,
+		 const char *text,
+		 gsize chunk_size,
+		 guint *counts)
+{
+	char *buffer;
+	gsize overlap, kept, length, done;
+	guint n_found;
+
+	overlap = nautilus_search_matcher_get_overlap (matcher);
+	buffer = g_malloc (overlap + chunk_size);
+
+	n_found = 0;
+	kept = 0;
+	for (done = 0; done < strlen (text); done += length) {
+		length = MIN (chunk_size, strlen (text) - done);
+		memcpy (buffer + kept, text + done, length);
+
+		n_found = nautilus_search_matcher_count_chunk (matcher, buffer, kept + length,
+							       kept, counts);
+
+		if (kept + length > overlap) {
+			memmove (buffer, buffer + kept + length - overlap, overlap);
+			kept = overlap;
+		} else {
+			kept += length;
+		}
+	}
+
+	g_free (buffer);
+
+	return n_found;
+}
+
+static void
+check (const char *text,
+       const char *query,
+       const guint *expected)
+{
+	NautilusSearchMatcher *matcher;
+	char **words;
+	guint *counts;
+	gsize chunk_size, length;
+	guint n_words, w;
+
+	words = g_strsplit (query, " ", -1);
+	matcher = nautilus_search_matcher_new (words);
+	n_words = nautilus_search_matcher_get_n_words (matcher);
+	counts = g_new0 (guint, n_words);
+	length = strlen (text);
+
+	nautilus_search_matcher_count (matcher, text, length, counts);
+	for (w = 0; w < n_words; w++) {
+		if (counts[w] != expected[w]) {
+			g_print ("\"%s\" in \"%s\": %u times, expected %u\n",
+				 words[w], text, counts[w], expected[w]);
+			failed = TRUE;
+		}
+	}
+
+	for (chunk_size = 1; chunk_size <= MAX (length, 1); chunk_size++) {
+		memset (counts, 0, n_words * sizeof (guint));
+		count_in_chunks (matcher, text, chunk_size, counts);
+
+		for (w = 0; w < n_words; w++) {
+			if (counts[w] != expected[w]) {
+				g_print ("\"%s\" in \"%s\" by %" G_GSIZE_FORMAT ": %u times, expected %u\n",
+					 words[w], text, chunk_size, counts[w], expected[w]);
+				failed = TRUE;
+			}
+		}
+	}
+
+	g_free (counts);
+	nautilus_search_matcher_free (matcher);
+	g_strfreev (words);
+}
+
+int
+main (int argc, char *argv[])
+{
+	NautilusSearchMatcher *matcher;
+	char *words[] = { "needle", NULL };
+	guint counts[1];
+
+	/* An empty file */
+	check ("", "needle", (guint[]) { 0 });
+
+	/* A word longer than the file */
+	check ("need", "needle", (guint[]) { 0 });
+	check ("a", "ab", (guint[]) { 0 });
+
+	/* Words across the chunk boundaries, at every chunk size */
+	check ("xxneedlexx", "needle", (guint[]) { 1 });
+	check ("needle", "needle", (guint[]) { 1 });
+	check ("NeedleneedleNEEDLE", "needle", (guint[]) { 3 });
+	check ("hellohello xlo", "hello lo", (guint[]) { 2, 3 });
+	check ("aaaa", "aa", (guint[]) { 3 });
+
+	matcher = nautilus_search_matcher_new (words);
+	memset (counts, 0, sizeof (counts));
+	if (nautilus_search_matcher_count (matcher, "", 0, counts) != 0 ||
+	    nautilus_search_matcher_match_all (matcher, "", 0) ||
+	    nautilus_search_matcher_match_all (matcher, "needl", 5)) {
+		g_print ("matched empty or short text\n");
+		failed = TRUE;
+	}
+	nautilus_search_matcher_free (matcher);
+
+	g_print ("%s\n", failed ? "FAILED" : "ok");
+
+	return failed ? 1 : 0;
+}
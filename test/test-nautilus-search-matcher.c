@@ -0,0 +1,206 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+
+/* Matches the words of a query against a synthetic corpus of file
+ * names, once the way the simple search engine used to (normalizing
+ * and lowercasing every name, then strstr for each word) and once the
+ * way it does now (ASCII names as they are, through a precompiled
+ * NautilusSearchMatcher), and compares time and results. The ASCII
+ * check the engine uses is also timed against a byte at a time one.
+ */
+
+#include <config.h>
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libnautilus-private/nautilus-search-matcher.h>
+
+#define DEFAULT_N_NAMES 1000000
+#define DEFAULT_QUERY "port 20"
+
+static const char *parts[] = {
+	"Report", "draft", "IMG_", "final", "notes", "Budget", "holiday",
+	"backup", "2012", "v2", "Übersicht", "café", "README", "index",
+	"photo", "scan", "résumé", "old", "copy", "export"
+};
+
+static const char *extensions[] = {
+	".txt", ".jpg", ".pdf", ".odt", ".png", ".c", ".h", ""
+};
+
+static char **
+make_corpus (int n_names)
+{
+	char **names;
+	GString *name;
+	int i, j, n_parts;
+
+	names = g_new0 (char *, n_names + 1);
+	name = g_string_new (NULL);
+
+	for (i = 0; i < n_names; i++) {
+		g_string_truncate (name, 0);
+		n_parts = g_random_int_range (1, 4);
+		for (j = 0; j < n_parts; j++) {
+			if (j > 0) {
+				g_string_append_c (name, '-');
+			}
+			g_string_append (name, parts[g_random_int_range (0, G_N_ELEMENTS (parts))]);
+		}
+		g_string_append_printf (name, "%d%s", g_random_int_range (0, 1000),
+					extensions[g_random_int_range (0, G_N_ELEMENTS (extensions))]);
+		names[i] = g_strdup (name->str);
+	}
+
+	g_string_free (name, TRUE);
+
+	return names;
+}
+
+static char **
+get_words (const char *text)
+{
+	char *normalized, *lower;
+	char **words;
+
+	normalized = g_utf8_normalize (text, -1, G_NORMALIZE_NFD);
+	lower = g_utf8_strdown (normalized, -1);
+	words = g_strsplit (lower, " ", -1);
+	g_free (lower);
+	g_free (normalized);
+
+	return words;
+}
+
+static gboolean
+matches_slow (const char *name, char **words)
+{
+	char *normalized, *lower;
+	gboolean found;
+	int i;
+
+	normalized = g_utf8_normalize (name, -1, G_NORMALIZE_NFD);
+	lower = g_utf8_strdown (normalized, -1);
+	g_free (normalized);
+
+	found = TRUE;
+	for (i = 0; found && words[i] != NULL; i++) {
+		found = strstr (lower, words[i]) != NULL;
+	}
+	g_free (lower);
+
+	return found;
+}
+
+static gboolean
+is_ascii_bytewise (const char *str, gsize length)
+{
+	gsize i;
+
+	for (i = 0; i < length; i++) {
+		if ((guchar) str[i] >= 0x80) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static gboolean
+matches_fast (const char *name, NautilusSearchMatcher *matcher)
+{
+	char *normalized, *lower;
+	gsize length;
+	gboolean found;
+
+	length = strlen (name);
+	if (nautilus_search_matcher_is_ascii (name, length)) {
+		return nautilus_search_matcher_match_all (matcher, name, length);
+	}
+
+	normalized = g_utf8_normalize (name, length, G_NORMALIZE_NFD);
+	lower = g_utf8_strdown (normalized, -1);
+	found = nautilus_search_matcher_match_all (matcher, lower, strlen (lower));
+	g_free (lower);
+	g_free (normalized);
+
+	return found;
+}
+
+int
+main (int argc, char *argv[])
+{
+	NautilusSearchMatcher *matcher;
+	GTimer *timer;
+	char **names, **words;
+	const char *query;
+	int n_names, n_slow, n_fast, n_ascii_bytewise, n_ascii, i;
+	gboolean failed;
+	double slow_time, fast_time, ascii_bytewise_time, ascii_time;
+
+	n_names = argc > 1 ? atoi (argv[1]) : DEFAULT_N_NAMES;
+	query = argc > 2 ? argv[2] : DEFAULT_QUERY;
+
+	g_print ("matching \"%s\" against %d names\n", query, n_names);
+	names = make_corpus (n_names);
+	words = get_words (query);
+	timer = g_timer_new ();
+
+	g_timer_start (timer);
+	n_slow = 0;
+	for (i = 0; i < n_names; i++) {
+		if (matches_slow (names[i], words)) {
+			n_slow++;
+		}
+	}
+	slow_time = g_timer_elapsed (timer, NULL);
+
+	g_timer_start (timer);
+	matcher = nautilus_search_matcher_new (words);
+	n_fast = 0;
+	for (i = 0; i < n_names; i++) {
+		if (matches_fast (names[i], matcher)) {
+			n_fast++;
+		}
+	}
+	fast_time = g_timer_elapsed (timer, NULL);
+
+	g_timer_start (timer);
+	n_ascii_bytewise = 0;
+	for (i = 0; i < n_names; i++) {
+		if (is_ascii_bytewise (names[i], strlen (names[i]))) {
+			n_ascii_bytewise++;
+		}
+	}
+	ascii_bytewise_time = g_timer_elapsed (timer, NULL);
+
+	g_timer_start (timer);
+	n_ascii = 0;
+	for (i = 0; i < n_names; i++) {
+		if (nautilus_search_matcher_is_ascii (names[i], strlen (names[i]))) {
+			n_ascii++;
+		}
+	}
+	ascii_time = g_timer_elapsed (timer, NULL);
+
+	failed = FALSE;
+	for (i = 0; i < n_names && !failed; i++) {
+		failed = matches_fast (names[i], matcher) != matches_slow (names[i], words) ||
+			nautilus_search_matcher_is_ascii (names[i], strlen (names[i])) !=
+			is_ascii_bytewise (names[i], strlen (names[i]));
+	}
+	nautilus_search_matcher_free (matcher);
+
+	g_print ("normalize and strstr: %d matches in %.2f s\n", n_slow, slow_time);
+	g_print ("matcher: %d matches in %.2f s\n", n_fast, fast_time);
+	g_print ("ASCII check, byte at a time: %d names in %.2f s\n",
+		 n_ascii_bytewise, ascii_bytewise_time);
+	g_print ("ASCII check, word at a time: %d names in %.2f s%s\n",
+		 n_ascii, ascii_time, failed ? ", MISMATCH" : "");
+
+	g_timer_destroy (timer);
+	g_strfreev (words);
+	g_strfreev (names);
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,138 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+
+/* Expands a directory with many subdirectories in the tree sidebar
+ * model, the way the tree view does, and measures how long it takes
+ * until the children are all in. Every inserted row is looked up
+ * again by its path, to check that paths and nth-child agree.
+ */
+
+#include <config.h>
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <src/nautilus-tree-sidebar-model.h>
+
+#define DEFAULT_N_CHILDREN 50000
+
+static GMainLoop *loop;
+static int n_inserted;
+static gboolean failed;
+
+static void
+row_inserted (GtkTreeModel *model,
+	      GtkTreePath *path,
+	      GtkTreeIter *iter,
+	      gpointer user_data)
+{
+	GtkTreeIter found;
+	GtkTreePath *found_path;
+
+	n_inserted++;
+
+	if (!gtk_tree_model_get_iter (model, &found, path)) {
+		failed = TRUE;
+		return;
+	}
+
+	found_path = gtk_tree_model_get_path (model, &found);
+	if (gtk_tree_path_compare (path, found_path) != 0) {
+		failed = TRUE;
+	}
+	gtk_tree_path_free (found_path);
+}
+
+static void
+row_loaded (FMTreeModel *model,
+	    GtkTreeIter *iter,
+	    gpointer user_data)
+{
+	g_main_loop_quit (loop);
+}
+
+static char *
+create_test_directory (int n_children)
+{
+	char *path, *child;
+	int i;
+
+	path = g_dir_make_tmp ("nautilus-tree-XXXXXX", NULL);
+	g_assert (path != NULL);
+
+	for (i = 0; i < n_children; i++) {
+		child = g_strdup_printf ("%s/%06d", path, i);
+		g_mkdir (child, 0700);
+		g_free (child);
+	}
+
+	return path;
+}
+
+static void
+remove_test_directory (const char *path, int n_children)
+{
+	char *child;
+	int i;
+
+	for (i = 0; i < n_children; i++) {
+		child = g_strdup_printf ("%s/%06d", path, i);
+		g_rmdir (child);
+		g_free (child);
+	}
+	g_rmdir (path);
+}
+
+int
+main (int argc, char *argv[])
+{
+	FMTreeModel *model;
+	GtkTreeIter root, dummy;
+	GIcon *icon;
+	GTimer *timer;
+	char *path, *uri;
+	int n_children;
+
+	gtk_init (&argc, &argv);
+
+	n_children = argc > 1 ? atoi (argv[1]) : DEFAULT_N_CHILDREN;
+
+	g_print ("creating %d directories\n", n_children);
+	path = create_test_directory (n_children);
+	uri = g_filename_to_uri (path, NULL, NULL);
+
+	model = fm_tree_model_new ();
+	fm_tree_model_set_show_only_directories (model, TRUE);
+
+	icon = g_themed_icon_new ("folder");
+	fm_tree_model_add_root_uri (model, uri, "test", icon, NULL);
+	g_object_unref (icon);
+
+	g_signal_connect (model, "row-inserted", G_CALLBACK (row_inserted), NULL);
+	g_signal_connect (model, "row-loaded", G_CALLBACK (row_loaded), NULL);
+
+	loop = g_main_loop_new (NULL, FALSE);
+	timer = g_timer_new ();
+
+	/* Expanding a row refs its first child, which starts loading */
+	gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (model), &root, NULL, 0);
+	gtk_tree_model_iter_children (GTK_TREE_MODEL (model), &dummy, &root);
+	gtk_tree_model_ref_node (GTK_TREE_MODEL (model), &dummy);
+
+	g_main_loop_run (loop);
+	g_timer_stop (timer);
+
+	g_print ("expanded %d children in %.2f s, %d rows inserted%s\n",
+		 gtk_tree_model_iter_n_children (GTK_TREE_MODEL (model), &root),
+		 g_timer_elapsed (timer, NULL), n_inserted,
+		 failed ? ", PATH MISMATCH" : "");
+
+	g_timer_destroy (timer);
+	g_main_loop_unref (loop);
+	g_object_unref (model);
+
+	remove_test_directory (path, n_children);
+	g_free (uri);
+	g_free (path);
+
+	return failed ? 1 : 0;
+}